@@ -71,15 +71,92 @@ typedef enum {
     LZOP_NO_FLUSH
 } LZOP_FLUSH_TYPE;
 
+/* compression methods, as in the lzop header */
+typedef enum {
+    LZOP_M_LZO1X_1    = 1,  /* lzop -2..-6 */
+    LZOP_M_LZO1X_1_15 = 2,  /* lzop -1 */
+    LZOP_M_LZO1X_999  = 3   /* lzop -7..-9 */
+} LZOP_METHOD;
+
+/* checksum of the uncompressed blocks written by deflate */
+typedef enum {
+    LZOP_CHK_ADLER32 = 0,
+    LZOP_CHK_CRC32   = 1,
+    LZOP_CHK_NONE    = 2
+} LZOP_CHECK;
+
+typedef struct lzop_options_s {
+    int level;         /* compression level (1..9), unused by inflate */
+    int method;        /* LZOP_METHOD, 0 = LZOP_M_LZO1X_999 */
+    int check;         /* LZOP_CHECK, unused by inflate */
+    int verify;        /* inflate: != 0 checks the block checksums stored in the stream */
+    uint32_t block_size; /* deflate: bytes per block, 0 = 256 KiB, at most 64 MiB */
+    uint32_t threads;  /* worker threads, 0 or 1 = work on the calling thread */
+} lzop_options;
+
 LZOP_STATUS lzop_inflateInit(lzop_streamp strm);
 LZOP_STATUS lzop_deflateInit(lzop_streamp strm, int level);
 
+/*
+ * With opt->threads > 1 the blocks are compressed concurrently by a pool
+ * of workers and emitted in order; the output is byte-identical to the
+ * single-threaded stream.
+ * lzop_deflate(strm, LZOP_FLUSH) returns LZOP_STREAM_END once the last
+ * byte of the stream has been copied to next_out, LZOP_OK if it has to be
+ * called again with more room in next_out.
+ */
+LZOP_STATUS lzop_deflateInit2(lzop_streamp strm, const lzop_options *opt);
+
+/*
+ * With opt->threads > 1 the block headers are scanned ahead of the
+ * caller and the next blocks are decompressed by a pool of workers,
+ * up to two blocks per worker are kept in flight.
+ * Blocks of any size up to the 64 MiB format limit are accepted, the
+ * buffers grow with the largest block seen.
+ */
+LZOP_STATUS lzop_inflateInit2(lzop_streamp strm, const lzop_options *opt);
+
 LZOP_STATUS lzop_inflateEnd(lzop_streamp strm);
 LZOP_STATUS lzop_deflateEnd(lzop_streamp strm);
 
 LZOP_STATUS lzop_inflate(lzop_streamp strm);
 LZOP_STATUS lzop_deflate(lzop_streamp strm, LZOP_FLUSH_TYPE flush);
 
+/*
+ * Worst case size of the whole stream (header, blocks and end marker) for
+ * size bytes of input: with that much room in next_out a single
+ * lzop_deflate(strm, LZOP_FLUSH) compresses every block in place.
+ */
+size_t lzop_deflateBound(lzop_streamp strm, size_t size);
+
+/*
+ * Random access: the block descriptors are enough to locate every block.
+ * lzop_inflateHeader decodes only the file header from next_in, it
+ *   returns LZOP_STREAM_END when the header is complete, LZOP_OK if more
+ *   input is needed.
+ * lzop_inflateBlockDescSize is the size of each block descriptor,
+ *   0 until the header is decoded; compressed blocks (dst_len < src_len)
+ *   have lzop_inflateBlockChkSize more bytes of checksums after it.
+ * lzop_inflateBlockDesc parses a descriptor, LZOP_STREAM_END on the end
+ *   of stream marker; the block data (dst_len bytes) follows it and
+ *   lzop_inflateBlock decodes it into src_len bytes at out.
+ * lzop_inflateBlockVerify is lzop_inflateBlock checking the block
+ *   checksums: desc is the descriptor followed by its checksums, as in
+ *   the stream, flags are the header flags (lzop_inflateBlockFlags, 0
+ *   until the header is decoded); LZOP_CORRUPTED_DATA on a mismatch.
+ * lzop_inflateReset drops any buffered data (and the blocks in flight),
+ *   the next input of lzop_inflate has to be a block descriptor.
+ */
+LZOP_STATUS lzop_inflateHeader(lzop_streamp strm);
+size_t lzop_inflateBlockDescSize(lzop_streamp strm);
+size_t lzop_inflateBlockChkSize(lzop_streamp strm);
+uint32_t lzop_inflateBlockFlags(lzop_streamp strm);
+LZOP_STATUS lzop_inflateBlockDesc(const uint8_t *desc, uint32_t *src_len, uint32_t *dst_len);
+LZOP_STATUS lzop_inflateBlock(const uint8_t *in, uint32_t dst_len, uint8_t *out, uint32_t src_len);
+LZOP_STATUS lzop_inflateBlockVerify(const uint8_t *desc, uint32_t flags,
+        const uint8_t *in, uint32_t dst_len, uint8_t *out, uint32_t src_len);
+LZOP_STATUS lzop_inflateReset(lzop_streamp strm);
+
 #ifdef __cplusplus
 }
 #endif
@@ -33,19 +33,43 @@
 #include <istream>
 #include <fstream>
 
+#include <zutil/zio.h>
+
 class ZFile
 {
 public:
-    virtual ~ZFile(){}
+    ZFile();
+    virtual ~ZFile();
+    /* the file owns its io backend */
+    ZFile(const ZFile&) = delete;
+    ZFile& operator=(const ZFile&) = delete;
+    /*
+     * I/O backend for the compressed file, ZIOStream if not set, call it
+     * before open(). It carries the sequential reads and writes and the
+     * repositioning of seek(); the random access side paths (building,
+     * saving and loading the seek indexes, the file size check against
+     * the index, readAt()) always open their own std::ifstream.
+     */
+    void setIO(ZIO *io);
     virtual void open(const char* filename, std::ios_base::openmode mode);
     virtual void close();
 
     virtual size_t write (const char* s, size_t n) = 0;
     virtual size_t read (char* s, size_t n) = 0;
+    /*
+     * Zero-copy read: peek() points s at the decoded data waiting in the
+     * internal buffer (decoding more if it is empty) and returns its size,
+     * 0 at the end of the stream; the data stays valid until the next call
+     * on the file. consume() marks the first n bytes of it as read.
+     */
+    virtual size_t peek (const char** s) = 0;
+    virtual void consume (size_t n) = 0;
     virtual bool eof() const;
 
 protected:
-    std::fstream fs;
+    size_t input(uint8_t* buf, size_t n, const uint8_t** next);
+
+    ZIO *io;
     std::ios_base::openmode mode;
     std::string filename;
 };
@@ -0,0 +1,90 @@
+/* zfileasync.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZFILEASYNC_H
+#define ZFILEASYNC_H
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include <zutil/zfile.h>
+#include <zutil/zthreadpool.h>
+
+/*
+ * Write-behind decorator: write() copies the data in a chunk and queues
+ * it, the wrapped ZFile compresses and writes it on a background thread.
+ * At most max_queued bytes wait in the queue, above that write() blocks
+ * until the oldest chunk is done. An error of the background thread is
+ * thrown by the next write() or by close(), which waits for the queue
+ * to drain. Reading goes straight to the wrapped file.
+ */
+class ZFileAsync: public ZFile
+{
+public:
+    struct options{
+        size_t chunk_size; /* small writes are joined up to this size */
+        size_t max_queued; /* bytes waiting for the background thread */
+        options():
+            chunk_size(1024 * 1024),
+            max_queued(16 * 1024 * 1024){}
+    };
+
+    /* takes ownership of zf */
+    ZFileAsync(ZFile *zf, const ZFileAsync::options &opt);
+    ZFileAsync(ZFile *zf);
+    ~ZFileAsync();
+
+    size_t write (const char* s, size_t n);
+    size_t read (char* s, size_t n);
+    size_t peek (const char** s);
+    void consume (size_t n);
+    void open(const char* filename, std::ios_base::openmode mode);
+    void close();
+    bool eof() const;
+
+private:
+    struct job{
+        size_t size;
+        std::future<void> done;
+    };
+    void flush();
+    void reap();
+
+    ZFile * zf;
+    ZFileAsync::options opt;
+    ZThreadPool * pool;
+    std::unique_ptr<std::vector<char>> current;
+    std::deque<job> jobs;
+    size_t queued;
+    std::atomic<bool> failed;
+    std::exception_ptr error;
+};
+
+#endif // ZFILEASYNC_H
@@ -0,0 +1,156 @@
+/* zfilebz2.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZFILEBZ2_H
+#define ZFILEBZ2_H
+
+#include <stdint.h>
+
+#include <bzlib.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <zutil/zfile.h>
+#include <zutil/zthreadpool.h>
+
+class ZFileBZ2: public ZFile
+{
+public:
+    struct options{
+        int level;           /* 1..9, block size in 100k units */
+        int work_factor;     /* 0..250, fallback sort threshold, 0 = 30 */
+        uint32_t threads;    /* > 1, pbzip2 style parallel compression and
+                              * decompression, 0 = one per core */
+        uint32_t block_size; /* threads > 1: input bytes compressed as a stream
+                              * of its own by each worker, 0 = level * 100000 */
+        options():
+            level(9),
+            work_factor(0),
+            threads(1 /* bzip2 stream on the calling thread */),
+            block_size(0){}
+
+        static options fastest(){
+            options o;
+            o.level = 1;
+            return o;
+        }
+        static options balanced(){
+            options o;
+            o.level = 6;
+            return o;
+        }
+        static options smallest(){
+            options o;
+            o.level = 9;
+            return o;
+        }
+    };
+
+    ZFileBZ2(const ZFileBZ2::options &opt);
+    ZFileBZ2();
+    ~ZFileBZ2();
+
+    size_t write (const char* s, size_t n);
+    size_t read (char* s, size_t n);
+    size_t peek (const char** s);
+    void consume (size_t n);
+    void open(const char* filename, std::ios_base::openmode mode);
+    void close();
+
+    uint64_t tell() const;
+
+    /*
+     * One-shot, in memory, on the calling thread: compress() writes a
+     * single stream into a buffer of the BZ2_bzBuffToBuffCompress() bound,
+     * decompress() grows the output, bzip2 does not record the size.
+     */
+    static std::vector<char> compress(const char* s, size_t n, const ZFileBZ2::options &opt = ZFileBZ2::options());
+    static std::vector<char> decompress(const char* s, size_t n);
+
+private:
+    bool fill();
+    bool fill(uint8_t *out, size_t size);
+
+    /*
+     * Writing, a chunk compressed by the pool as a whole bzip2 stream;
+     * reading, a block cut out of the stream (or just the crc at the end
+     * of a stream) and decoded by the pool.
+     */
+    struct block{
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        uint64_t bits;  /* block bits, starting at bit shift of in[0] */
+        int shift;
+        char level;     /* '1'..'9' from the stream header */
+        uint32_t crc;   /* block crc, the combined one at the end of a stream */
+        bool eos;
+        bool ok;
+        std::future<void> done;
+    };
+    static void deflateBlock(block *b, const ZFileBZ2::options &opt);
+    static void inflateBlock(block *b);
+    size_t writeParallel (const char* s, size_t n);
+    void submitBlock();
+    void drainBlocks(bool all);
+    bool fillParallel();
+    bool splitBlocks();
+    void submitSplit(uint64_t end);
+    void readRaw();
+
+    bz_stream strm;
+    uint8_t * inbuf;
+    uint8_t * outbuf;
+    const uint8_t * outdata;
+    size_t outsize;
+    size_t offsetbuf;
+    int status;
+    bool end;                       /* nothing else to decode */
+    ZFileBZ2::options opt;
+    ZThreadPool * pool;
+    std::deque<std::unique_ptr<block>> blocks;
+    std::unique_ptr<block> current;
+    std::vector<uint8_t> blockout;  /* decoded block being read */
+    unsigned int streams;
+    /* parallel reading: the compressed data is split at the block magics */
+    std::vector<uint8_t> raw;
+    uint64_t rawbase;               /* file offset of raw[0] */
+    uint64_t scan;                  /* next byte to search */
+    uint64_t window;                /* last 64 bits searched */
+    uint64_t lowbit;                /* first bit a magic can start at */
+    uint64_t blockstart;            /* bit offset of the block being split */
+    uint64_t streamstart;           /* byte offset of the next stream header */
+    bool header;                    /* a stream header is expected */
+    bool parsed;                    /* nothing else to split */
+    char level;
+    uint32_t hcrc;                  /* combined crc of the block headers */
+    uint32_t combined;              /* combined crc of the decoded blocks */
+    uint64_t pos;
+};
+
+#endif // ZFILEBZ2_H
@@ -30,25 +30,133 @@
 
 #include <zlib.h>
 
+#include <deque>
+#include <memory>
+#include <vector>
+
 #include <zutil/zfile.h>
+#include <zutil/zthreadpool.h>
 
 class ZFileGZ: public ZFile
 {
 public:
+    struct options{
+        int level;         /* 0..9, Z_BEST_SPEED .. Z_BEST_COMPRESSION */
+        int mem_level;     /* 1..9, memory for the match state, 9 is the fastest */
+        int window_bits;   /* 9..15 */
+        enum STRATEGY{
+            default_strategy = Z_DEFAULT_STRATEGY,
+            filtered = Z_FILTERED,
+            huffman_only = Z_HUFFMAN_ONLY,
+            rle = Z_RLE,
+            fixed = Z_FIXED
+        } strategy;
+        uint32_t threads;  /* > 1, pigz style parallel compression */
+        size_t block_size; /* input chunk compressed by each worker */
+        uint64_t index_span; /* uncompressed bytes between seek access points */
+        options():
+            level(Z_BEST_COMPRESSION),
+            mem_level(8),
+            window_bits(15),
+            strategy(default_strategy),
+            threads(1 /* zlib stream on the calling thread */),
+            block_size(128 * 1024),
+            index_span(4 * 1024 * 1024){}
+
+        static options fastest(){
+            options o;
+            o.level = Z_BEST_SPEED;
+            o.mem_level = 9;
+            return o;
+        }
+        static options balanced(){
+            options o;
+            o.level = 6;
+            o.mem_level = 9;
+            return o;
+        }
+        static options smallest(){
+            options o;
+            o.level = Z_BEST_COMPRESSION;
+            o.mem_level = 9;
+            return o;
+        }
+    };
+
+    ZFileGZ(const ZFileGZ::options &opt);
     ZFileGZ();
     ~ZFileGZ();
 
     size_t write (const char* s, size_t n);
     size_t read (char* s, size_t n);
+    size_t peek (const char** s);
+    void consume (size_t n);
     void open(const char* filename, std::ios_base::openmode mode);
     void close();
 
+    /*
+     * One-shot, in memory, on the calling thread: compress() makes a
+     * single deflate() call into a deflateBound() buffer, decompress()
+     * allocates the ISIZE of the gzip trailer and only grows past it for
+     * concatenated members or data above 4 GiB.
+     */
+    static std::vector<char> compress(const char* s, size_t n, const ZFileGZ::options &opt = ZFileGZ::options());
+    static std::vector<char> decompress(const char* s, size_t n);
+
+    /*
+     * Random access on the uncompressed data (read mode), zran style:
+     * the first seek builds an index of access points, one every
+     * index_span bytes, each with the 32k window needed to resume
+     * inflating there; the index can be saved in a sidecar file and
+     * loaded back instead of scanning the whole stream again.
+     */
+    bool seek(uint64_t offset);
+    uint64_t tell() const;
+    void buildIndex();
+    void saveIndex(const char* filename);
+    bool loadIndex(const char* filename);
+
 private:
+    bool fill();
+    bool fill(uint8_t *out, size_t size);
+    struct point{
+        uint64_t out;   /* uncompressed offset */
+        uint64_t in;    /* compressed offset of the first full byte */
+        int bits;       /* bits of the previous byte still to be used */
+        std::vector<uint8_t> window;
+    };
+    void restart(const point *p);
+
+    /* a chunk deflated by the pool, primed with the tail of the previous one */
+    struct block{
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> dict;
+        std::vector<uint8_t> out;
+        uLong crc;
+        bool last;
+        std::future<void> done;
+    };
+    static void deflateBlock(block *b, const ZFileGZ::options &opt);
+    size_t writeParallel (const char* s, size_t n);
+    void submitBlock(bool last);
+    void drainBlocks(bool all);
+
     z_stream strm  = {nullptr};
     uint8_t * inbuf;
     uint8_t * outbuf;
     size_t offsetbuf;
     int status;
+    ZFileGZ::options opt;
+    ZThreadPool * pool;
+    std::deque<std::unique_ptr<block>> blocks;
+    std::unique_ptr<block> current;
+    std::vector<uint8_t> window;
+    uLong crc;
+    uint32_t isize;
+    std::vector<point> index;
+    bool indexed;
+    uint64_t length;
+    uint64_t pos;
 };
 
 #endif // ZFILEGZIP_H
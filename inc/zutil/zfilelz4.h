@@ -0,0 +1,124 @@
+/* zfilelz4.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZFILELZ4_H
+#define ZFILELZ4_H
+
+#include <stdint.h>
+
+#include <lz4frame.h>
+#include <lz4hc.h>
+
+#include <vector>
+
+#include <zutil/zfile.h>
+
+
+class ZFileLZ4: public ZFile
+{
+public:
+    struct options{
+        int level;              /* 0 = fast lz4, negative levels are faster,
+                                 * LZ4HC_CLEVEL_MIN (3)..LZ4HC_CLEVEL_MAX (12) = lz4 hc */
+        enum BLOCK_SIZE{
+            max64KB = LZ4F_max64KB,
+            max256KB = LZ4F_max256KB,
+            max1MB = LZ4F_max1MB,
+            max4MB = LZ4F_max4MB
+        } block_size;
+        bool block_independent; /* blocks do not reference the previous one,
+                                 * a little bigger, less memory to decode */
+        bool checksum;          /* content checksum at the end of the frame */
+        bool block_checksum;    /* checksum of each compressed block */
+        options():
+            level(0),
+            block_size(max4MB),
+            block_independent(true),
+            checksum(true),
+            block_checksum(false){}
+
+        static options fastest(){
+            options o;
+            o.level = 0;
+            return o;
+        }
+        static options balanced(){
+            options o;
+            o.level = LZ4HC_CLEVEL_DEFAULT;
+            return o;
+        }
+        static options smallest(){
+            options o;
+            o.level = LZ4HC_CLEVEL_MAX;
+            o.block_independent = false;
+            return o;
+        }
+    };
+
+    ZFileLZ4(const ZFileLZ4::options &opt);
+    ZFileLZ4();
+    ~ZFileLZ4();
+
+    size_t write (const char* s, size_t n);
+    size_t read (char* s, size_t n);
+    size_t peek (const char** s);
+    void consume (size_t n);
+    void open(const char* filename, std::ios_base::openmode mode);
+    void close();
+
+    uint64_t tell() const;
+
+    /*
+     * One-shot, in memory, on the calling thread: compress() is a single
+     * LZ4F_compressFrame() into a LZ4F_compressFrameBound() buffer and
+     * records the content size, decompress() allocates it from the frame
+     * header, frames without it grow the output.
+     */
+    static std::vector<char> compress(const char* s, size_t n, const ZFileLZ4::options &opt = ZFileLZ4::options());
+    static std::vector<char> decompress(const char* s, size_t n);
+
+private:
+    bool fill();
+    bool fill(uint8_t *out, size_t size);
+    static void preferences(const ZFileLZ4::options &opt, LZ4F_preferences_t *prefs);
+
+    LZ4F_cctx * cctx;
+    LZ4F_dctx * dctx;
+    const uint8_t * next_in;
+    size_t avail_in;
+    uint8_t * inbuf;
+    uint8_t * outbuf;
+    size_t outbufsize;              /* LZ4F_compressBound() of a ZBUFSIZELZ4 write */
+    size_t outsize;                 /* decoded bytes in the outbuf */
+    size_t offsetbuf;
+    bool end;                       /* nothing else to decode */
+    size_t hint;                    /* last LZ4F_decompress() return, 0 at the end of a frame */
+    ZFileLZ4::options opt;
+    uint64_t pos;
+};
+
+#endif // ZFILELZ4_H
@@ -30,6 +30,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <zutil/lzop.h>
 
 #include <zutil/zfile.h>
@@ -38,20 +40,112 @@
 class ZFileLZO: public ZFile
 {
 public:
+    struct options{
+        enum METHOD{
+            lzo1x_1 = LZOP_M_LZO1X_1,
+            lzo1x_1_15 = LZOP_M_LZO1X_1_15,
+            lzo1x_999 = LZOP_M_LZO1X_999
+        } method;
+        int level;        /* 1..9, lzo1x_999 effort, only recorded in the header by the others */
+        enum CHK{
+            adler32 = LZOP_CHK_ADLER32, /* default */
+            crc32 = LZOP_CHK_CRC32,
+            none = LZOP_CHK_NONE
+        } chk;            /* checksum of each block written */
+        bool verify;      /* check the block checksums while reading */
+        uint32_t block_size; /* uncompressed bytes per block written, up to 64 MiB */
+        uint32_t threads; /* workers compressing/decompressing blocks */
+        options():
+            method(lzo1x_999),
+            level(9),
+            chk(adler32),
+            verify(false),
+            block_size(256 * 1024),
+            threads(1 /* work on the calling thread */){}
+
+        /* the lzop -1, -3 and -9 settings */
+        static options fastest(){
+            options o;
+            o.method = lzo1x_1_15;
+            o.level = 1;
+            return o;
+        }
+        static options balanced(){
+            options o;
+            o.method = lzo1x_1;
+            o.level = 3;
+            return o;
+        }
+        static options smallest(){
+            options o;
+            o.level = 9;
+            return o;
+        }
+    };
+
+    ZFileLZO(const ZFileLZO::options &opt);
     ZFileLZO();
     ~ZFileLZO();
 
     size_t write (const char* s, size_t n);
     size_t read (char* s, size_t n);
+    size_t peek (const char** s);
+    void consume (size_t n);
     void open(const char* filename, std::ios_base::openmode mode);
     void close();
 
+    /*
+     * One-shot, in memory, on the calling thread: compress() sizes the
+     * output with lzop_deflateBound(), decompress() adds up the src_len of
+     * the block descriptors and decodes every block in place.
+     */
+    static std::vector<char> compress(const char* s, size_t n, const ZFileLZO::options &opt = ZFileLZO::options());
+    static std::vector<char> decompress(const char* s, size_t n);
+
+    /*
+     * Random access on the uncompressed data (read mode): the first call
+     * scans the block descriptors (the blocks themselves are skipped) to
+     * build a table of the blocks, it can be saved in a sidecar file and
+     * loaded back. Only the blocks covering the offset are decoded.
+     * readAt() is pread style and does not move the read position.
+     */
+    bool seek(uint64_t offset);
+    uint64_t tell() const;
+    size_t readAt(uint64_t offset, char* s, size_t n);
+    void buildIndex();
+    void saveIndex(const char* filename);
+    bool loadIndex(const char* filename);
+
 private:
+    bool fill();
+    bool fill(uint8_t *out, size_t size);
+    struct block{
+        uint64_t in;    /* offset of the block descriptor */
+        uint64_t out;   /* uncompressed offset */
+        uint32_t src_len;
+        uint32_t dst_len;
+    };
+    static size_t readHeader(lzop_streamp strm, uint8_t *buf, size_t size);
+    size_t blockAt(uint64_t offset) const;
+    uint64_t dataAt(const block &b) const;
+
     lzop_stream strm;
     uint8_t * inbuf;
     uint8_t * outbuf;
     size_t offsetbuf;
     LZOP_STATUS status;
+    ZFileLZO::options opt;
+    std::vector<block> index;
+    size_t descsize;
+    size_t chksize;                 /* compressed data checksums, compressed blocks only */
+    bool indexed;
+    uint64_t length;
+    uint64_t pos;
+    std::ifstream rafs;             /* readAt() has its own file position */
+    size_t rablock;                 /* block decoded in racache */
+    uint32_t raflags;               /* header flags, for the block checksums */
+    std::vector<uint8_t> racache;
+    std::vector<uint8_t> rain;
 };
 
 #endif // ZFILELZO_H
@@ -30,6 +30,8 @@
 
 #include <lzma.h>
 
+#include <vector>
+
 #include <zutil/zfile.h>
 
 /* Use custom allocator for the lzma lib */
@@ -53,11 +55,55 @@ public:
             arm,
             x86
         } filter;
+        /* LZMA2 knobs on top of the preset, the zero values keep the preset ones */
+        enum MODE{
+            mode_preset = 0,
+            fast = LZMA_MODE_FAST,
+            normal = LZMA_MODE_NORMAL
+        } mode;
+        enum MF{
+            mf_preset = 0,
+            hc3 = LZMA_MF_HC3,
+            hc4 = LZMA_MF_HC4,
+            bt2 = LZMA_MF_BT2,
+            bt3 = LZMA_MF_BT3,
+            bt4 = LZMA_MF_BT4
+        } mf;                /* match finder */
+        uint32_t nice_len;   /* 2..273, longer is slower and smaller */
+        uint32_t depth;      /* match finder cycles */
+        uint32_t threads;    /* 0 = one per core */
+        uint64_t block_size; /* multithreaded encoder only, 0 = 3 x dict_size */
+        uint64_t memlimit;   /* multithreaded decoder only, above it the blocks are
+                              * decoded on fewer threads, 0 = 1/4 of the RAM */
         options():
             preset(LZMA_PRESET_DEFAULT /* 6 */),
             dict_size(LZMA_DICT_SIZE_DEFAULT /* 8M */),
             chk(crc64),
-            filter(lzma2){}
+            filter(lzma2),
+            mode(mode_preset),
+            mf(mf_preset),
+            nice_len(0),
+            depth(0),
+            threads(1),
+            block_size(0),
+            memlimit(0){}
+
+        static options fastest(){
+            options o;
+            o.preset = 0;
+            o.nice_len = 32;
+            return o;
+        }
+        static options balanced(){
+            options o;
+            o.preset = 3;
+            return o;
+        }
+        static options smallest(){
+            options o;
+            o.preset = 9 | LZMA_PRESET_EXTREME;
+            return o;
+        }
     };
 
     ZFileXZ(const ZFileXZ::options &opt);
@@ -66,10 +112,35 @@ public:
 
     size_t write (const char* s, size_t n);
     size_t read (char* s, size_t n);
+    size_t peek (const char** s);
+    void consume (size_t n);
     void open(const char* filename, std::ios_base::openmode mode);
     void close();
 
+    /*
+     * One-shot, in memory, on the calling thread: compress() is a single
+     * lzma_stream_buffer_encode() into a lzma_stream_buffer_bound() buffer,
+     * decompress() allocates the uncompressed size read from the index of
+     * every stream and decodes with a single lzma_code().
+     */
+    static std::vector<char> compress(const char* s, size_t n, const ZFileXZ::options &opt = ZFileXZ::options());
+    static std::vector<char> decompress(const char* s, size_t n);
+
+    /*
+     * Random access on the uncompressed data (read mode): the first seek
+     * reads the block index at the end of the file, then only the block
+     * with the offset is decoded and reading goes on block by block.
+     */
+    bool seek(uint64_t offset);
+    uint64_t tell() const;
+
 private:
+    bool fill();
+    bool fill(uint8_t *out, size_t size);
+    bool readIndex();
+    bool openBlock();
+    static lzma_filter * filterChain(const ZFileXZ::options &opt, lzma_options_lzma *opt_lzma2, lzma_filter *filters);
+
 #ifdef XZ_ALLOCATOR 
     static void *_alloc(void *opaque, size_t nmemb, size_t size);
     static void _free(void *opaque, void *ptr);
@@ -84,6 +155,10 @@ private:
     lzma_filter * filters;
     ZFileXZ::options opt;
     lzma_options_lzma opt_lzma2;
+    lzma_index * index;
+    lzma_index_iter iter;
+    bool blockmode;
+    uint64_t pos;
 };
 
 #endif // ZFILEXZ_H
@@ -0,0 +1,116 @@
+/* zfilezstd.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZFILEZSTD_H
+#define ZFILEZSTD_H
+
+#include <stdint.h>
+
+#include <zstd.h>
+
+#include <vector>
+
+#include <zutil/zfile.h>
+
+
+class ZFileZSTD: public ZFile
+{
+public:
+    struct options{
+        int level;           /* 1..ZSTD_maxCLevel(), negative levels are faster */
+        uint32_t threads;    /* compression workers, 0 = one per core, decoding
+                              * always runs on the calling thread */
+        uint32_t window_log; /* 0 = set by the level; when reading, windows above
+                              * the default limit (2^27) need it set as well */
+        bool long_distance;  /* long distance matching, window_log 27 unless set */
+        bool checksum;       /* content checksum at the end of the frame */
+        options():
+            level(ZSTD_CLEVEL_DEFAULT /* 3 */),
+            threads(1),
+            window_log(0),
+            long_distance(false),
+            checksum(true){}
+
+        static options fastest(){
+            options o;
+            o.level = 1;
+            return o;
+        }
+        static options balanced(){
+            options o;
+            o.level = 6;
+            return o;
+        }
+        static options smallest(){
+            options o;
+            o.level = 19;
+            o.long_distance = true;
+            return o;
+        }
+    };
+
+    ZFileZSTD(const ZFileZSTD::options &opt);
+    ZFileZSTD();
+    ~ZFileZSTD();
+
+    size_t write (const char* s, size_t n);
+    size_t read (char* s, size_t n);
+    size_t peek (const char** s);
+    void consume (size_t n);
+    void open(const char* filename, std::ios_base::openmode mode);
+    void close();
+
+    uint64_t tell() const;
+
+    /*
+     * One-shot, in memory, on the calling thread: compress() is a single
+     * ZSTD_compress2() into a ZSTD_compressBound() buffer, decompress()
+     * allocates the content sizes of the frames and decodes them with a
+     * single ZSTD_decompressDCtx(), frames without it grow the output.
+     */
+    static std::vector<char> compress(const char* s, size_t n, const ZFileZSTD::options &opt = ZFileZSTD::options());
+    static std::vector<char> decompress(const char* s, size_t n);
+
+private:
+    bool fill();
+    bool fill(uint8_t *out, size_t size);
+    static size_t setParameters(ZSTD_CCtx *cctx, const ZFileZSTD::options &opt, uint32_t threads);
+
+    ZSTD_CCtx * cctx;
+    ZSTD_DCtx * dctx;
+    ZSTD_inBuffer in;
+    ZSTD_outBuffer out;
+    uint8_t * inbuf;
+    uint8_t * outbuf;
+    size_t offsetbuf;
+    bool end;                       /* nothing else to decode */
+    size_t hint;                    /* last ZSTD_decompressStream() return, 0 at the end of a frame */
+    ZFileZSTD::options opt;
+    uint64_t pos;
+};
+
+#endif // ZFILEZSTD_H
@@ -0,0 +1,77 @@
+/* zio.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZIO_H
+#define ZIO_H
+
+#include <stdint.h>
+
+#include <fstream>
+
+/*
+ * File I/O backend used by ZFile, read() and write() are sequential,
+ * a short read means the end of the file has been reached (eof()).
+ */
+class ZIO
+{
+public:
+    virtual ~ZIO(){}
+    virtual bool open(const char* filename, std::ios_base::openmode mode) = 0;
+    virtual void close() = 0;
+
+    virtual size_t read (char* s, size_t n) = 0;
+    virtual size_t write (const char* s, size_t n) = 0;
+    /* absolute position for the next read, clears eof() */
+    virtual bool seek(uint64_t offset) = 0;
+    virtual bool eof() const = 0;
+
+    /*
+     * Zero-copy read, only when mappable(): points s at the next bytes of
+     * the file (at most n) and moves past them, the data stays valid until
+     * the next call on the backend.
+     */
+    virtual bool mappable() const { return false; }
+    virtual size_t map(const char** s, size_t n) { (void)s; (void)n; return 0; }
+};
+
+/* std::fstream based backend, the default one */
+class ZIOStream: public ZIO
+{
+public:
+    bool open(const char* filename, std::ios_base::openmode mode);
+    void close();
+
+    size_t read (char* s, size_t n);
+    size_t write (const char* s, size_t n);
+    bool seek(uint64_t offset);
+    bool eof() const;
+
+private:
+    std::fstream fs;
+};
+
+#endif // ZIO_H
@@ -0,0 +1,80 @@
+/* ziofd.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZIOFD_H
+#define ZIOFD_H
+
+#include <zutil/zio.h>
+
+/*
+ * Raw file descriptor backend: large pread/pwrite through an aligned
+ * buffer, access pattern hints with posix_fadvise and optional O_DIRECT.
+ */
+class ZIOFd: public ZIO
+{
+public:
+    struct options{
+        bool direct;     /* O_DIRECT, bypass the page cache */
+        bool sequential; /* POSIX_FADV_SEQUENTIAL, more readahead */
+        bool dontneed;   /* drop the pages behind us (POSIX_FADV_DONTNEED) */
+        size_t bufsize;  /* size of each pread/pwrite, multiple of 4k */
+        options():
+            direct(false),
+            sequential(true),
+            dontneed(false),
+            bufsize(1024 * 1024){}
+    };
+
+    ZIOFd(const ZIOFd::options &opt);
+    ZIOFd();
+    ~ZIOFd();
+
+    bool open(const char* filename, std::ios_base::openmode mode);
+    void close();
+
+    size_t read (char* s, size_t n);
+    size_t write (const char* s, size_t n);
+    bool seek(uint64_t offset);
+    bool eof() const;
+
+private:
+    bool flush();
+    void advise();
+
+    ZIOFd::options opt;
+    int fd;
+    std::ios_base::openmode mode;
+    uint8_t * buf;
+    uint64_t bufbase;   /* file offset of buf */
+    size_t buflen;      /* valid bytes in buf */
+    uint64_t pos;       /* next byte to be read or written */
+    uint64_t dropped;   /* pages before this offset are already dropped */
+    uint64_t started;   /* writeback started up to this offset */
+    bool eofflag;
+};
+
+#endif // ZIOFD_H
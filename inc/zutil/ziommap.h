@@ -0,0 +1,83 @@
+/* ziommap.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZIOMMAP_H
+#define ZIOMMAP_H
+
+#include <zutil/zio.h>
+
+/*
+ * Read only backend on a memory mapped file: the decoders read the
+ * compressed data straight from the mapping (see ZIO::map()).
+ * The file is mapped a window at a time so files larger than the
+ * address space work as well.
+ */
+class ZIOMmap: public ZIO
+{
+public:
+    struct options{
+        size_t window;    /* size of the mapping, multiple of the page size */
+        size_t readahead; /* MADV_WILLNEED this much ahead, 0 to disable */
+        bool release;     /* MADV_DONTNEED the pages already read */
+        options():
+            window(sizeof(void*) < 8 ? (64 * 1024 * 1024) : (1024 * 1024 * 1024)),
+            readahead(8 * 1024 * 1024),
+            release(false){}
+    };
+
+    ZIOMmap(const ZIOMmap::options &opt);
+    ZIOMmap();
+    ~ZIOMmap();
+
+    bool open(const char* filename, std::ios_base::openmode mode);
+    void close();
+
+    size_t read (char* s, size_t n);
+    size_t write (const char* s, size_t n);
+    bool seek(uint64_t offset);
+    bool eof() const;
+
+    bool mappable() const { return true; }
+    size_t map(const char** s, size_t n);
+
+private:
+    bool remap(uint64_t offset);
+    void advise(uint64_t done);
+
+    ZIOMmap::options opt;
+    int fd;
+    uint64_t size;      /* file size */
+    uint8_t * base;     /* mapping */
+    uint64_t mapoff;    /* file offset of the mapping */
+    size_t maplen;
+    uint64_t pos;
+    uint64_t advised;   /* MADV_WILLNEED issued up to this offset */
+    uint64_t released;  /* MADV_DONTNEED issued up to this offset */
+    bool eofflag;
+};
+
+#endif // ZIOMMAP_H
@@ -0,0 +1,99 @@
+/* zioreadahead.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZIOREADAHEAD_H
+#define ZIOREADAHEAD_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#include <zutil/zio.h>
+
+/*
+ * Read-ahead decorator: an I/O thread reads the file through the wrapped
+ * backend into a ring of depth buffers while the decoder works on the
+ * previous ones. The ring is a single producer / single consumer queue,
+ * the indexes are atomics and the lock is only taken to sleep when the
+ * ring is full or empty. Writes go straight to the wrapped backend.
+ */
+class ZIOReadAhead: public ZIO
+{
+public:
+    struct options{
+        unsigned depth;  /* buffers in the ring */
+        size_t bufsize;  /* size of each read */
+        options():
+            depth(4),
+            bufsize(1024 * 1024){}
+    };
+
+    /* takes ownership of io, ZIOStream if null */
+    ZIOReadAhead(const ZIOReadAhead::options &opt, ZIO *io = nullptr);
+    ZIOReadAhead();
+    ~ZIOReadAhead();
+
+    bool open(const char* filename, std::ios_base::openmode mode);
+    void close();
+
+    size_t read (char* s, size_t n);
+    size_t write (const char* s, size_t n);
+    bool seek(uint64_t offset);
+    bool eof() const;
+
+    bool mappable() const;
+    size_t map(const char** s, size_t n);
+
+private:
+    struct slot{
+        std::vector<uint8_t> buf;
+        size_t len;
+        bool last;
+    };
+
+    void start();
+    void stop();
+    void reader();
+
+    ZIOReadAhead::options opt;
+    ZIO * io;
+    std::ios_base::openmode mode;
+    std::vector<slot> slots;
+    std::atomic<uint64_t> filled;   /* slots filled by the reader */
+    std::atomic<uint64_t> taken;    /* slots given back by the consumer */
+    std::atomic<bool> quit;
+    std::mutex lock;
+    std::condition_variable ready;  /* a slot has been filled */
+    std::condition_variable room;   /* a slot has been given back */
+    std::thread thread;
+    size_t headoff;                 /* bytes used in the head slot */
+    bool eofflag;
+};
+
+#endif // ZIOREADAHEAD_H
@@ -0,0 +1,98 @@
+/* ziouring.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZIOURING_H
+#define ZIOURING_H
+
+#include <vector>
+
+#include <zutil/zio.h>
+
+/*
+ * io_uring backend: keeps up to depth reads ahead of the decoder, or
+ * depth writes behind the encoder, in flight while the codec works.
+ * Falls back to ZIOFd when the kernel does not provide io_uring.
+ */
+class ZIOUring: public ZIO
+{
+public:
+    struct options{
+        unsigned depth;  /* requests in flight */
+        size_t bufsize;  /* size of each request */
+        options():
+            depth(4),
+            bufsize(1024 * 1024){}
+    };
+
+    ZIOUring(const ZIOUring::options &opt);
+    ZIOUring();
+    ~ZIOUring();
+
+    bool open(const char* filename, std::ios_base::openmode mode);
+    void close();
+
+    size_t read (char* s, size_t n);
+    size_t write (const char* s, size_t n);
+    bool seek(uint64_t offset);
+    bool eof() const;
+
+    bool mappable() const;
+    size_t map(const char** s, size_t n);
+
+    /* false when running on the ZIOFd fallback */
+    bool active() const { return nullptr != this->ring; }
+
+private:
+    struct uring;
+    struct slot{
+        uint8_t * buf;
+        uint64_t offset;
+        size_t len;      /* requested */
+        long res;        /* completed size or -errno */
+        bool busy;
+    };
+
+    bool setup();
+    void teardown();
+    void submit(unsigned i, uint64_t offset, size_t len);
+    bool complete(unsigned i);
+    void start(uint64_t offset);
+    bool drain();
+
+    ZIOUring::options opt;
+    uring * ring;
+    ZIO * fallback;
+    int fd;
+    std::ios_base::openmode mode;
+    std::vector<slot> slots;
+    unsigned head;      /* slot being read from or filled */
+    size_t headoff;     /* bytes already used in the head slot */
+    uint64_t next;      /* file offset of the next request */
+    bool eofflag;
+};
+
+#endif // ZIOURING_H
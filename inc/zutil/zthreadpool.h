@@ -0,0 +1,62 @@
+/* zthreadpool.h -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#ifndef ZTHREADPOOL_H
+#define ZTHREADPOOL_H
+
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+/*
+ * Fixed set of worker threads running jobs in submission order,
+ * the returned future reports the completion (or the exception) of each job.
+ */
+class ZThreadPool
+{
+public:
+    ZThreadPool(unsigned int threads);
+    ~ZThreadPool();
+
+    std::future<void> submit(std::function<void()> job);
+    unsigned int size() const;
+
+private:
+    void worker();
+
+    std::vector<std::thread> threads;
+    std::deque<std::packaged_task<void()>> jobs;
+    std::mutex lock;
+    std::condition_variable work;
+    bool quit;
+};
+
+#endif // ZTHREADPOOL_H
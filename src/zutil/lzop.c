@@ -29,11 +29,14 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include <zutil/lzop.h>
 
 #include <lzo/lzoconf.h>
 #include <lzo/lzo1x.h>
+/* adler32() and crc32() match the lzo ones and are vectorized by the zlib builds */
+#include <zlib.h>
 
 // #define DEBUG
 
@@ -115,7 +118,11 @@
  * is not possible.
  */
 #define ZBUFSIZELZOP_IN      ( BLOCK_SIZE )
-#define ZBUFSIZELZOP_OUT     (ZBUFSIZELZOP_IN + ZBUFSIZELZOP_IN / 16 + 64 + 3)
+#define ZBUFSIZELZOP_OUT(__in)   ((__in) + (__in) / 16 + 64 + 3)
+/* room for a whole block, descriptor included, in the caller's buffer */
+#define ZBUFSIZELZOP_BLOCK(__in) (3*4 + ZBUFSIZELZOP_OUT(__in))
+/* the header and the end of stream marker share the outbuf with the first/last block */
+#define ZBUFSIZELZOP_HEADER  (512)
 
 static const uint8_t lzop_magic[9] =
     { 0x89, 0x4c, 0x5a, 0x4f, 0x00, 0x0d, 0x0a, 0x1a, 0x0a };
@@ -188,6 +195,8 @@ typedef struct lzop_header_s{
     H_STATUS  ready;
     size_t size /* Header Size */;
     size_t blocksize; /* sizeof block descriptor */
+    size_t chksize;   /* compressed data checksums, after the descriptor of compressed blocks */
+    int verify;       /* check the block checksums while inflating */
     /* > Magic */
     uint16_t version;
     uint16_t lib_version;
@@ -208,31 +217,235 @@ typedef struct lzop_header_s{
 enum S_INF{
     S_INF_HEADER,
     S_INF_BLOCK_DESC,
-    S_INF_BLOCK_DATA
+    S_INF_BLOCK_DATA,
+    S_INF_END
 };
 
 enum S_DEF{
     S_DEF_HEADER,
     S_DEF_BLOCK_DESC,
-    S_DEF_BLOCK_DATA
+    S_DEF_BLOCK_DATA,
+    S_DEF_END
+};
+
+/*************************************************************************
+// worker pool, blocks are processed out of order and handed back in order
+**************************************************************************/
+
+typedef enum {
+    J_FREE = 0,
+    J_QUEUED,
+    J_RUNNING,
+    J_DONE,
+    J_FAILED
+} J_STATUS;
+
+typedef struct lzop_chk_s{
+    uint32_t src_adler32;
+    uint32_t src_crc32;
+    uint32_t dst_adler32;
+    uint32_t dst_crc32;
+} lzop_chk;
+
+typedef struct lzop_job_s{
+    uint8_t *inbuf;
+    size_t insize;
+    size_t inbufsize;
+    uint8_t *outbuf;
+    size_t outsize;
+    size_t outbufsize;
+    uint8_t *wrkmem;
+    lzop_chk chk;
+    J_STATUS status;
+} lzop_job;
+
+typedef struct lzop_pool_s lzop_pool;
+
+struct lzop_pool_s{
+    pthread_t *threads;
+    uint32_t nthreads;
+    lzop_job *jobs;
+    uint32_t njobs;
+    uint32_t head;    /* oldest job not yet handed back */
+    uint32_t pending; /* jobs queued after head, the next one is being filled */
+    uint32_t next;    /* next job to be picked by a worker */
+    int quit;
+    const lzop_header *header;
+    LZOP_STATUS (*run)(lzop_pool *pool, lzop_job *job);
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
 };
 
 typedef struct lzop_data_s{
     uint8_t *inbuf;
     size_t insize;
+    size_t inbufsize;
     uint8_t *outbuf;
     size_t outsize;
+    size_t outbufsize;
+    size_t outpos;      /* outbuf is handed over by cursor, 0 once empty */
+    size_t blksize;     /* deflate: uncompressed bytes per block */
     uint8_t *wrkmem;
     size_t wrksize;
     uint32_t src_len;
     uint32_t dst_len;
-    uint32_t src_adler32;
-    uint32_t src_crc32;
-    uint32_t dst_adler32;
-    uint32_t dst_crc32;
+    lzop_chk chk;
     int state;
+    lzop_pool *pool;
 } lzop_data;
 
+static void *_lzop_pool_worker(void *arg){
+    lzop_pool *pool = (lzop_pool *)arg;
+    pthread_mutex_lock(&pool->lock);
+    while (1){
+        while (!pool->quit && pool->jobs[pool->next].status != J_QUEUED){
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->quit){
+            break;
+        }
+        lzop_job *job = &pool->jobs[pool->next];
+        pool->next = (pool->next + 1) % pool->njobs;
+        job->status = J_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+
+        LZOP_STATUS ret = pool->run(pool, job);
+
+        pthread_mutex_lock(&pool->lock);
+        job->status = (LZOP_OK == ret) ? J_DONE : J_FAILED;
+        pthread_cond_broadcast(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void _lzop_pool_destroy(lzop_pool *pool){
+    uint32_t i;
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->nthreads; i++){
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (i = 0; i < pool->njobs; i++){
+        free(pool->jobs[i].inbuf);
+        free(pool->jobs[i].outbuf);
+        free(pool->jobs[i].wrkmem);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool->jobs);
+    free(pool);
+}
+
+static lzop_pool *_lzop_pool_create(
+        uint32_t nthreads, const lzop_header *header,
+        LZOP_STATUS (*run)(lzop_pool *pool, lzop_job *job),
+        size_t insize, size_t outsize, size_t wrksize){
+    uint32_t i;
+    lzop_pool *pool = (lzop_pool *) calloc(1, sizeof(lzop_pool));
+    if (!pool){
+        return NULL;
+    }
+    /* two jobs per worker, so the workers are busy while the caller drains */
+    pool->njobs = 2 * nthreads;
+    pool->header = header;
+    pool->run = run;
+    pool->jobs = (lzop_job *) calloc(pool->njobs, sizeof(lzop_job));
+    pool->threads = (pthread_t *) calloc(nthreads, sizeof(pthread_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    if (!pool->jobs || !pool->threads){
+        _lzop_pool_destroy(pool);
+        return NULL;
+    }
+    for (i = 0; i < pool->njobs; i++){
+        pool->jobs[i].inbuf  = (uint8_t*) malloc(insize);
+        pool->jobs[i].inbufsize = insize;
+        pool->jobs[i].outbuf = (uint8_t*) malloc(outsize);
+        pool->jobs[i].outbufsize = outsize;
+        pool->jobs[i].wrkmem = wrksize ? (uint8_t*) malloc(wrksize) : NULL;
+        if (!pool->jobs[i].inbuf || !pool->jobs[i].outbuf || (wrksize && !pool->jobs[i].wrkmem)){
+            _lzop_pool_destroy(pool);
+            return NULL;
+        }
+    }
+    for (i = 0; i < nthreads; i++){
+        if (pthread_create(&pool->threads[i], NULL, _lzop_pool_worker, pool)){
+            break;
+        }
+        pool->nthreads++;
+    }
+    if (pool->nthreads != nthreads){
+        _lzop_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+/* the job being filled by the caller */
+static lzop_job *_lzop_pool_slot(lzop_pool *pool){
+    return &pool->jobs[(pool->head + pool->pending) % pool->njobs];
+}
+
+static void _lzop_pool_submit(lzop_pool *pool){
+    pthread_mutex_lock(&pool->lock);
+    _lzop_pool_slot(pool)->status = J_QUEUED;
+    pool->pending++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* status of the oldest job, optionally waiting for it to complete */
+static J_STATUS _lzop_pool_head(lzop_pool *pool, int wait){
+    J_STATUS status;
+    pthread_mutex_lock(&pool->lock);
+    while (wait && (pool->jobs[pool->head].status == J_QUEUED || pool->jobs[pool->head].status == J_RUNNING)){
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    status = pool->jobs[pool->head].status;
+    pthread_mutex_unlock(&pool->lock);
+    return status;
+}
+
+/* hand the oldest (completed) job back, swapping its output buffer with 'outbuf' */
+static lzop_job *_lzop_pool_pop(lzop_pool *pool, uint8_t **outbuf, size_t *outbufsize){
+    lzop_job *job = &pool->jobs[pool->head];
+    uint8_t *tmp = *outbuf;
+    size_t tmpsize = *outbufsize;
+    *outbuf = job->outbuf;
+    *outbufsize = job->outbufsize;
+    job->outbuf = tmp;
+    job->outbufsize = tmpsize;
+    pthread_mutex_lock(&pool->lock);
+    job->status = J_FREE;
+    pool->head = (pool->head + 1) % pool->njobs;
+    pool->pending--;
+    pthread_mutex_unlock(&pool->lock);
+    return job;
+}
+
+/* make room for size bytes in buf, the contents are dropped */
+static int _lzop_buf_grow(uint8_t **buf, size_t *bufsize, size_t size){
+    uint8_t *tmp;
+    if (*bufsize >= size){
+        return 1;
+    }
+    tmp = (uint8_t*) malloc(size);
+    if (!tmp){
+        return 0;
+    }
+    free(*buf);
+    *buf = tmp;
+    *bufsize = size;
+    return 1;
+}
+
 
 
 
@@ -299,43 +512,169 @@ static void _lzop_print_header(lzop_streamp strm){
     if (((lzop_header*)(strm->header))->flags & F_CS_UTF8)   printf("  F_CS_UTF8\n");
 }
 
+/* the checksums of the compressed data (if any) are stored only for compressed blocks */
+static LZOP_STATUS _lzop_block_verify_c(const lzop_header *header, const lzop_chk *chk,
+        const uint8_t *in, uint32_t dst_len, uint32_t src_len){
+    if (!header->verify || dst_len >= src_len){
+        return LZOP_OK;
+    }
+    if ((header->flags & F_ADLER32_C) &&
+        chk->dst_adler32 != adler32(ADLER32_INIT_VALUE, in, dst_len)){
+        return LZOP_CORRUPTED_DATA;
+    }
+    if ((header->flags & F_CRC32_C) &&
+        chk->dst_crc32 != crc32(CRC32_INIT_VALUE, in, dst_len)){
+        return LZOP_CORRUPTED_DATA;
+    }
+    return LZOP_OK;
+}
+
+static LZOP_STATUS _lzop_block_verify_d(const lzop_header *header, const lzop_chk *chk,
+        const uint8_t *out, uint32_t src_len){
+    if (!header->verify){
+        return LZOP_OK;
+    }
+    if ((header->flags & F_ADLER32_D) &&
+        chk->src_adler32 != adler32(ADLER32_INIT_VALUE, out, src_len)){
+        return LZOP_CORRUPTED_DATA;
+    }
+    if ((header->flags & F_CRC32_D) &&
+        chk->src_crc32 != crc32(CRC32_INIT_VALUE, out, src_len)){
+        return LZOP_CORRUPTED_DATA;
+    }
+    return LZOP_OK;
+}
+
+static LZOP_STATUS _lzop_pool_inflate(lzop_pool *pool, lzop_job *job){
+    /* job->insize = dst_len, job->outsize = src_len */
+    if (LZOP_OK != _lzop_block_verify_c(pool->header, &job->chk, job->inbuf, job->insize, job->outsize) ||
+        LZOP_OK != lzop_inflateBlock(job->inbuf, job->insize, job->outbuf, job->outsize)){
+        return LZOP_CORRUPTED_DATA;
+    }
+    return _lzop_block_verify_d(pool->header, &job->chk, job->outbuf, job->outsize);
+}
+
 LZOP_STATUS lzop_inflateInit(lzop_streamp strm){
+    lzop_options opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.threads = 1;
+    return lzop_inflateInit2(strm, &opt);
+}
+
+LZOP_STATUS lzop_inflateInit2(lzop_streamp strm, const lzop_options *opt){
     strm->header = malloc(sizeof(lzop_header));
     strm->data = malloc(sizeof(lzop_data));
-    ((lzop_data*)(strm->data))->inbuf  = (uint8_t*) malloc(ZBUFSIZELZOP_IN);
+    ((lzop_data*)(strm->data))->inbuf  = NULL;
     ((lzop_data*)(strm->data))->insize = 0;
+    ((lzop_data*)(strm->data))->inbufsize = ZBUFSIZELZOP_IN;
     ((lzop_data*)(strm->data))->outbuf = (uint8_t*) malloc(ZBUFSIZELZOP_IN);
     ((lzop_data*)(strm->data))->outsize = 0;
+    ((lzop_data*)(strm->data))->outbufsize = ZBUFSIZELZOP_IN;
+    ((lzop_data*)(strm->data))->outpos = 0;
+    ((lzop_data*)(strm->data))->blksize = 0;
+    ((lzop_data*)(strm->data))->pool = NULL;
+    ((lzop_data*)(strm->data))->state = S_INF_HEADER;
 
     ((lzop_data*)(strm->data))->src_len = 0;
     ((lzop_data*)(strm->data))->dst_len = 0;
     ((lzop_header*)(strm->header))->ready = HEADER_NOT_READY;
     ((lzop_header*)(strm->header))->size  = sizeof(lzop_magic);
+    ((lzop_header*)(strm->header))->verify = opt->verify;
+
+    if (opt->threads > 1){
+        /* headers and compressed blocks are collected straight into the job being filled */
+        ((lzop_data*)(strm->data))->pool = _lzop_pool_create(
+                opt->threads, (lzop_header*)(strm->header), _lzop_pool_inflate,
+                ZBUFSIZELZOP_IN, ZBUFSIZELZOP_IN, 0);
+        if (!((lzop_data*)(strm->data))->pool){
+            lzop_inflateEnd(strm);
+            return LZOP_ERROR;
+        }
+        ((lzop_data*)(strm->data))->inbuf = _lzop_pool_slot(((lzop_data*)(strm->data))->pool)->inbuf;
+    }else{
+        ((lzop_data*)(strm->data))->inbuf  = (uint8_t*) malloc(ZBUFSIZELZOP_IN);
+    }
     return LZOP_OK;
 }
 
+static LZOP_STATUS _lzop_block_write(const lzop_header *header,
+        uint8_t *in, size_t insize, uint8_t *out, size_t *outsize, uint8_t *wrkmem);
+
+static LZOP_STATUS _lzop_pool_deflate(lzop_pool *pool, lzop_job *job){
+    return _lzop_block_write(pool->header, job->inbuf, job->insize, job->outbuf, &job->outsize, job->wrkmem);
+}
+
 LZOP_STATUS lzop_deflateInit(lzop_streamp strm, int level){
+    lzop_options opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.level = level;
+    opt.threads = 1;
+    return lzop_deflateInit2(strm, &opt);
+}
+
+LZOP_STATUS lzop_deflateInit2(lzop_streamp strm, const lzop_options *opt){
+    size_t wrksize;
     strm->header = malloc(sizeof(lzop_header));
     strm->data = malloc(sizeof(lzop_data));
-    ((lzop_data*)(strm->data))->inbuf  = (uint8_t*) malloc(ZBUFSIZELZOP_IN);
+    ((lzop_data*)(strm->data))->blksize = opt->block_size ? opt->block_size : ZBUFSIZELZOP_IN;
+    ((lzop_data*)(strm->data))->inbuf  = NULL;
     ((lzop_data*)(strm->data))->insize = 0;
-    ((lzop_data*)(strm->data))->outbuf = (uint8_t*) malloc(ZBUFSIZELZOP_OUT);
+    ((lzop_data*)(strm->data))->inbufsize = ((lzop_data*)(strm->data))->blksize;
+    ((lzop_data*)(strm->data))->outbufsize = ZBUFSIZELZOP_BLOCK(((lzop_data*)(strm->data))->blksize) + ZBUFSIZELZOP_HEADER;
+    ((lzop_data*)(strm->data))->outbuf = (uint8_t*) malloc(((lzop_data*)(strm->data))->outbufsize);
     ((lzop_data*)(strm->data))->outsize = 0;
-    ((lzop_data*)(strm->data))->wrkmem = (uint8_t*) malloc(LZO1X_999_MEM_COMPRESS);
+    ((lzop_data*)(strm->data))->outpos = 0;
+    ((lzop_data*)(strm->data))->wrkmem = NULL;
     ((lzop_data*)(strm->data))->wrksize = 0;
+    ((lzop_data*)(strm->data))->pool = NULL;
+    ((lzop_data*)(strm->data))->state = S_DEF_HEADER;
 
     ((lzop_data*)(strm->data))->src_len = 0;
     ((lzop_data*)(strm->data))->dst_len = 0;
     ((lzop_header*)(strm->header))->ready = HEADER_NOT_READY;
     ((lzop_header*)(strm->header))->size  = 38;
 
+    if (opt->block_size > MAX_BLOCK_SIZE){
+        lzop_deflateEnd(strm);
+        return LZOP_ERROR;
+    }
+
     /* Populate Header */
     ((lzop_header*)(strm->header))->version = 0x1040; /* this implementation is based on LZOP 1.04 */
     ((lzop_header*)(strm->header))->version_needed_to_extract = 0x0940;
     ((lzop_header*)(strm->header))->lib_version = lzo_version() & 0xffff;
-    ((lzop_header*)(strm->header))->method = 3; /* M_LZO1X_999 */
-    ((lzop_header*)(strm->header))->level = level;
-    ((lzop_header*)(strm->header))->flags = F_OS_UNIX | F_ADLER32_D | F_STDIN | F_STDOUT ;
+    switch (opt->method){
+        case LZOP_M_LZO1X_1:
+            wrksize = LZO1X_1_MEM_COMPRESS;
+            break;
+        case LZOP_M_LZO1X_1_15:
+            wrksize = LZO1X_1_15_MEM_COMPRESS;
+            break;
+        case 0:
+        case LZOP_M_LZO1X_999:
+            wrksize = LZO1X_999_MEM_COMPRESS;
+            break;
+        default:
+            lzop_deflateEnd(strm);
+            return LZOP_ERROR;
+    }
+    ((lzop_header*)(strm->header))->method = opt->method ? opt->method : LZOP_M_LZO1X_999;
+    ((lzop_header*)(strm->header))->level = opt->level;
+    ((lzop_header*)(strm->header))->flags = F_OS_UNIX | F_STDIN | F_STDOUT ;
+    switch (opt->check){
+        case LZOP_CHK_ADLER32:
+            ((lzop_header*)(strm->header))->flags |= F_ADLER32_D;
+            break;
+        case LZOP_CHK_CRC32:
+            ((lzop_header*)(strm->header))->flags |= F_CRC32_D;
+            break;
+        case LZOP_CHK_NONE:
+            break;
+        default:
+            lzop_deflateEnd(strm);
+            return LZOP_ERROR;
+    }
+    ((lzop_header*)(strm->header))->verify = 0;
     ((lzop_header*)(strm->header))->filter = 0;
     ((lzop_header*)(strm->header))->mode = 0;
     ((lzop_header*)(strm->header))->mtime_low = 0;
@@ -344,6 +683,22 @@ LZOP_STATUS lzop_deflateInit(lzop_streamp strm, int level){
 
     ((lzop_header*)(strm->header))->chk = 0;
 
+    if (opt->threads > 1){
+        /* the caller fills the input buffer of the current job */
+        ((lzop_data*)(strm->data))->pool = _lzop_pool_create(
+                opt->threads, (lzop_header*)(strm->header), _lzop_pool_deflate,
+                ((lzop_data*)(strm->data))->blksize,
+                ZBUFSIZELZOP_BLOCK(((lzop_data*)(strm->data))->blksize) + ZBUFSIZELZOP_HEADER, wrksize);
+        if (!((lzop_data*)(strm->data))->pool){
+            lzop_deflateEnd(strm);
+            return LZOP_ERROR;
+        }
+        ((lzop_data*)(strm->data))->inbuf = _lzop_pool_slot(((lzop_data*)(strm->data))->pool)->inbuf;
+    }else{
+        ((lzop_data*)(strm->data))->inbuf  = (uint8_t*) malloc(((lzop_data*)(strm->data))->blksize);
+        ((lzop_data*)(strm->data))->wrkmem = (uint8_t*) malloc(wrksize);
+    }
+
 #ifdef DEBUG
     _lzop_print_header(strm);
 #endif
@@ -351,6 +706,12 @@ LZOP_STATUS lzop_deflateInit(lzop_streamp strm, int level){
 }
 
 LZOP_STATUS lzop_inflateEnd(lzop_streamp strm){
+    if (strm->data && ((lzop_data*)(strm->data))->pool){
+        /* the input buffer belongs to the pool */
+        _lzop_pool_destroy(((lzop_data*)(strm->data))->pool);
+        ((lzop_data*)(strm->data))->pool = NULL;
+        ((lzop_data*)(strm->data))->inbuf = NULL;
+    }
     if (strm->header)
         free(strm->header);
     if (strm->data){
@@ -366,6 +727,12 @@ LZOP_STATUS lzop_inflateEnd(lzop_streamp strm){
 }
 
 LZOP_STATUS lzop_deflateEnd(lzop_streamp strm){
+    if (strm->data && ((lzop_data*)(strm->data))->pool){
+        /* stop the workers before the header goes away, the input buffer belongs to the pool */
+        _lzop_pool_destroy(((lzop_data*)(strm->data))->pool);
+        ((lzop_data*)(strm->data))->pool = NULL;
+        ((lzop_data*)(strm->data))->inbuf = NULL;
+    }
     if (strm->header)
         free(strm->header);
     if (strm->data){
@@ -390,14 +757,23 @@ static size_t _lzop_fillbuffer_in(lzop_streamp strm, size_t size){
         // PD("FBI lb: %ld tbc:%ld\n", leftBytes, toBeCopyed);
         memcpy(((lzop_data*)(strm->data))->inbuf + ((lzop_data*)(strm->data))->insize, strm->next_in, toBeCopyed);
         ((lzop_data*)(strm->data))->insize += toBeCopyed;
+        strm->next_in += toBeCopyed;
         strm->avail_in -= toBeCopyed;
-        if (strm->avail_in > 0){
-            memcpy(strm->next_in, strm->next_in+toBeCopyed, strm->avail_in);
-        }
     }
     return ((lzop_data*)(strm->data))->insize;
 }
 
+/* copy the pending output at next_out + out_offset, returns the new offset */
+static size_t _lzop_drain_out(lzop_streamp strm, size_t out_offset){
+    lzop_data *data = (lzop_data*)(strm->data);
+    size_t toBeCopyed = data->outsize > strm->avail_out ? strm->avail_out : data->outsize;
+    memcpy(strm->next_out + out_offset, data->outbuf + data->outpos, toBeCopyed);
+    strm->avail_out -= toBeCopyed;
+    data->outsize -= toBeCopyed;
+    data->outpos = data->outsize ? data->outpos + toBeCopyed : 0;
+    return out_offset + toBeCopyed;
+}
+
 /*
 static size_t _lzop_fillbuffer_out(lzop_streamp strm, size_t size){
     PD("FBO size: %ld %ld\n", size, strm->avail_in);
@@ -546,26 +922,274 @@ static LZOP_STATUS _lzop_header_write(lzop_streamp strm){
     }
 }
 
+/* parse the block descriptor collected in inbuf */
+/*
+ * the descriptor is in inbuf once this returns true, the checksums of the
+ * compressed data follow the fixed part only for compressed blocks
+ */
+static int _lzop_block_desc_fill(lzop_streamp strm){
+    lzop_header *header = (lzop_header*)(strm->header);
+    lzop_data *data = (lzop_data*)(strm->data);
+    if (_lzop_fillbuffer_in(strm, header->blocksize) < header->blocksize){
+        return 0;
+    }
+    uint32_t src_len = fromBe32(*(uint32_t*)(&data->inbuf[0]));
+    uint32_t dst_len = fromBe32(*(uint32_t*)(&data->inbuf[4]));
+    size_t size = header->blocksize + ((src_len && dst_len < src_len) ? header->chksize : 0);
+    return _lzop_fillbuffer_in(strm, size) >= size;
+}
+
+/* the checksums after the lengths of the descriptor at desc */
+static void _lzop_block_chk_read(uint32_t flags, const uint8_t *desc,
+        uint32_t dst_len, uint32_t src_len, lzop_chk *chk){
+    size_t offset = 8;
+    if (flags & F_ADLER32_D){
+        chk->src_adler32 = fromBe32(*(uint32_t*)(&desc[offset]));
+        offset += 4;
+    }
+    if (flags & F_CRC32_D){
+        chk->src_crc32 = fromBe32(*(uint32_t*)(&desc[offset]));
+        offset += 4;
+    }
+    if (dst_len < src_len){
+        if (flags & F_ADLER32_C){
+            chk->dst_adler32 = fromBe32(*(uint32_t*)(&desc[offset]));
+            offset += 4;
+        }
+        if (flags & F_CRC32_C){
+            chk->dst_crc32 = fromBe32(*(uint32_t*)(&desc[offset]));
+            offset += 4;
+        }
+    }
+}
+
+static void _lzop_block_desc_read(lzop_streamp strm){
+    lzop_header *header = (lzop_header*)(strm->header);
+    lzop_data *data = (lzop_data*)(strm->data);
+    data->src_len = fromBe32(*(uint32_t*)(&data->inbuf[0]));
+    data->dst_len = fromBe32(*(uint32_t*)(&data->inbuf[4]));
+    _lzop_block_chk_read(header->flags, data->inbuf, data->dst_len, data->src_len, &data->chk);
+    PD("Inflate src_len: 0x%08X\n", data->src_len);
+    PD("Inflate dst_len: 0x%08X\n", data->dst_len);
+    PD("Inflate src_adler32: 0x%08X\n", data->chk.src_adler32);
+    PD("Inflate src_crc32: 0x%08X\n", data->chk.src_crc32);
+    PD("Inflate dst_adler32: 0x%08X\n", data->chk.dst_adler32);
+    PD("Inflate dst_crc32: 0x%08X\n", data->chk.dst_crc32);
+}
+
+LZOP_STATUS lzop_inflateHeader(lzop_streamp strm){
+    if (!((lzop_header*)(strm->header))->ready){
+        if (LZOP_OK != _lzop_header_read(strm)){
+            return LZOP_ERROR;
+        }
+        if (!((lzop_header*)(strm->header))->ready){
+            return LZOP_OK;
+        }
+#ifdef DEBUG
+        _lzop_print_header(strm);
+#endif
+        ((lzop_header*)(strm->header))->blocksize = 4 + 4 +
+            ((((lzop_header*)(strm->header))->flags & F_ADLER32_D)?4:0) +
+            ((((lzop_header*)(strm->header))->flags & F_CRC32_D)?4:0) ;
+        ((lzop_header*)(strm->header))->chksize =
+            ((((lzop_header*)(strm->header))->flags & F_ADLER32_C)?4:0) +
+            ((((lzop_header*)(strm->header))->flags & F_CRC32_C)?4:0) ;
+        ((lzop_data*)(strm->data))->insize = 0;
+        ((lzop_data*)(strm->data))->state = S_INF_BLOCK_DESC;
+        PD("Inflate blocksize: 0x%08lX\n", ((lzop_header*)(strm->header))->blocksize);
+    }
+    return LZOP_STREAM_END;
+}
+
+size_t lzop_inflateBlockDescSize(lzop_streamp strm){
+    if (!((lzop_header*)(strm->header))->ready){
+        return 0;
+    }
+    return ((lzop_header*)(strm->header))->blocksize;
+}
+
+size_t lzop_inflateBlockChkSize(lzop_streamp strm){
+    if (!((lzop_header*)(strm->header))->ready){
+        return 0;
+    }
+    return ((lzop_header*)(strm->header))->chksize;
+}
+
+uint32_t lzop_inflateBlockFlags(lzop_streamp strm){
+    if (!((lzop_header*)(strm->header))->ready){
+        return 0;
+    }
+    return ((lzop_header*)(strm->header))->flags;
+}
+
+LZOP_STATUS lzop_inflateBlockDesc(const uint8_t *desc, uint32_t *src_len, uint32_t *dst_len){
+    *src_len = fromBe32(*(uint32_t*)(&desc[0]));
+    *dst_len = fromBe32(*(uint32_t*)(&desc[4]));
+    if (0 == *src_len){
+        return LZOP_STREAM_END;
+    }
+    if (*src_len > MAX_BLOCK_SIZE || *dst_len > *src_len){
+        return LZOP_CORRUPTED_DATA;
+    }
+    return LZOP_OK;
+}
+
+LZOP_STATUS lzop_inflateBlock(const uint8_t *in, uint32_t dst_len, uint8_t *out, uint32_t src_len){
+    if (dst_len < src_len){
+        lzo_uint outsize = src_len;
+        if (LZO_E_OK != lzo1x_decompress_safe(in, dst_len, out, &outsize, NULL) ||
+            outsize != src_len){
+            return LZOP_CORRUPTED_DATA;
+        }
+    }else{
+        memcpy(out, in, dst_len);
+    }
+    return LZOP_OK;
+}
+
+LZOP_STATUS lzop_inflateBlockVerify(const uint8_t *desc, uint32_t flags,
+        const uint8_t *in, uint32_t dst_len, uint8_t *out, uint32_t src_len){
+    lzop_header header;
+    lzop_chk chk;
+    memset(&header, 0, sizeof(header));
+    memset(&chk, 0, sizeof(chk));
+    header.flags = flags;
+    header.verify = 1;
+    _lzop_block_chk_read(flags, desc, dst_len, src_len, &chk);
+    if (LZOP_OK != _lzop_block_verify_c(&header, &chk, in, dst_len, src_len) ||
+        LZOP_OK != lzop_inflateBlock(in, dst_len, out, src_len)){
+        return LZOP_CORRUPTED_DATA;
+    }
+    return _lzop_block_verify_d(&header, &chk, out, src_len);
+}
+
+LZOP_STATUS lzop_inflateReset(lzop_streamp strm){
+    lzop_data *data = (lzop_data*)(strm->data);
+    if (!((lzop_header*)(strm->header))->ready){
+        return LZOP_ERROR;
+    }
+    if (data->pool){
+        /* let the workers finish the blocks in flight and drop them */
+        while (data->pool->pending){
+            _lzop_pool_head(data->pool, 1);
+            _lzop_pool_pop(data->pool, &data->outbuf, &data->outbufsize);
+        }
+        data->inbuf = _lzop_pool_slot(data->pool)->inbuf;
+    }
+    data->insize = 0;
+    data->outsize = 0;
+    data->outpos = 0;
+    data->src_len = 0;
+    data->dst_len = 0;
+    data->state = S_INF_BLOCK_DESC;
+    return LZOP_OK;
+}
+
+/*
+ * Multithreaded Inflate Workflow
+ *    --->  next_in, avail_in
+ *           \--> job[head+pending].inbuf, insize == dst_len (filled by the caller)
+ *                  \-> workers -> job[n].outbuf
+ *    <---  next_out, avail_out  <-- outbuf <-- job[head].outbuf (in order)
+ */
+static LZOP_STATUS _lzop_inflate_mt(lzop_streamp strm){
+    lzop_data *data = (lzop_data*)(strm->data);
+    lzop_header *header = (lzop_header*)(strm->header);
+    lzop_pool *pool = data->pool;
+    size_t out_offset = 0;
+    while (1){
+        /* check if there are left bytes that can be copyed in the avail_out */
+        if (data->outsize){
+            out_offset = _lzop_drain_out(strm, out_offset);
+            if (data->outsize > 0){
+                return LZOP_OK;
+            }
+        }
+        /* phase 1, decode the header */
+        if (!header->ready){
+            LZOP_STATUS ret = lzop_inflateHeader(strm);
+            if (LZOP_STREAM_END != ret){
+                return ret;
+            }
+        }
+        /*
+         * the oldest block goes out first; wait for it only when there is
+         * nothing else to do, otherwise keep scanning the blocks ahead
+         */
+        if (pool->pending){
+            int wait = (pool->pending == pool->njobs) ||
+                       (S_INF_END == data->state) ||
+                       (0 == strm->avail_in && 0 == out_offset);
+            switch (_lzop_pool_head(pool, wait)){
+                case J_FAILED:
+                    return LZOP_CORRUPTED_DATA;
+                case J_DONE:
+                    data->outsize = _lzop_pool_pop(pool, &data->outbuf, &data->outbufsize)->outsize;
+                    continue;
+                default:
+                    break;
+            }
+        }
+        if (S_INF_END == data->state){
+            return LZOP_STREAM_END;
+        }
+        /* here at least one job is free, the block is collected in its inbuf */
+        data->inbuf = _lzop_pool_slot(pool)->inbuf;
+        if (S_INF_BLOCK_DESC == data->state){
+            if (!_lzop_block_desc_fill(strm)){
+                if (data->insize >= 4 && 0 == fromBe32(*(uint32_t*)(data->inbuf))){
+                    /* the end of the stream is reached */
+                    data->state = S_INF_END;
+                    continue;
+                }
+                return LZOP_OK;
+            }
+            _lzop_block_desc_read(strm);
+            data->insize = 0;
+            if (0 == data->src_len){
+                data->state = S_INF_END;
+                continue;
+            }
+            if (data->src_len > MAX_BLOCK_SIZE || data->dst_len > data->src_len){
+                return LZOP_CORRUPTED_DATA;
+            }
+            /* blocks larger than the default get bigger buffers in their job */
+            if (!_lzop_buf_grow(&_lzop_pool_slot(pool)->inbuf, &_lzop_pool_slot(pool)->inbufsize, data->dst_len) ||
+                !_lzop_buf_grow(&_lzop_pool_slot(pool)->outbuf, &_lzop_pool_slot(pool)->outbufsize, data->src_len)){
+                return LZOP_ERROR;
+            }
+            data->inbuf = _lzop_pool_slot(pool)->inbuf;
+            data->state = S_INF_BLOCK_DATA;
+        }
+        if (_lzop_fillbuffer_in(strm, data->dst_len) < data->dst_len){
+            return LZOP_OK;
+        }
+        _lzop_pool_slot(pool)->insize = data->dst_len;
+        _lzop_pool_slot(pool)->outsize = data->src_len;
+        _lzop_pool_slot(pool)->chk = data->chk;
+        _lzop_pool_submit(pool);
+        data->insize = 0;
+        data->state = S_INF_BLOCK_DESC;
+    }
+}
+
 /*
  * Inflate Workflow
  *    --->  next_in, avail_in
- *           \--> inbuf, insize == dst_len
- *                  \-> inflate -> outbuf, outsize
+ *           \--> inbuf, insize == dst_len (only if the block is split across calls)
+ *                  \-> inflate -> outbuf, outsize (only if next_out is too small)
  *    <---  next_out, avail_out  <--/
  */
 LZOP_STATUS lzop_inflate(lzop_streamp strm){
+    if (((lzop_data*)(strm->data))->pool){
+        return _lzop_inflate_mt(strm);
+    }
     size_t out_offset = 0;
     while(strm->avail_in > 0 || strm->avail_out > 0 ){
         /* check if there are left bytes that can be copyed in the avail_out */
-        if ( strm->avail_out > 0 && ((lzop_data*)(strm->data))->outsize ){
-            size_t toBeCopyed = ((lzop_data*)(strm->data))->outsize > strm->avail_out ? strm->avail_out : ((lzop_data*)(strm->data))->outsize;
-            memcpy(strm->next_out+out_offset, ((lzop_data*)(strm->data))->outbuf, toBeCopyed);
-            strm->avail_out -= toBeCopyed;
-            out_offset += toBeCopyed;
-            ((lzop_data*)(strm->data))->outsize -= toBeCopyed;
-            if(((lzop_data*)(strm->data))->outsize > 0){
-                memcpy(((lzop_data*)(strm->data))->outbuf, ((lzop_data*)(strm->data))->outbuf+toBeCopyed, ((lzop_data*)(strm->data))->outsize);
-            }
+        if ( ((lzop_data*)(strm->data))->outsize ){
+            out_offset = _lzop_drain_out(strm, out_offset);
+            /* do not decode a new block over the one still waiting to be copyed */
             if (strm->avail_out==0){
                 return LZOP_OK;
             }
@@ -573,20 +1197,12 @@ LZOP_STATUS lzop_inflate(lzop_streamp strm){
         PD("Deflate 001 avail_in: %ld  h_ready: %d  dst_len: %d\n", strm->avail_in, ((lzop_header*)(strm->header))->ready, ((lzop_data*)(strm->data))->dst_len);
         /* phase 1, decode the header */
         if (!((lzop_header*)(strm->header))->ready){
-            if (LZOP_OK != _lzop_header_read(strm)){
+            if (LZOP_ERROR == lzop_inflateHeader(strm)){
                 return LZOP_ERROR;
             }
-            if (((lzop_header*)(strm->header))->ready){
-#ifdef DEBUG
-                _lzop_print_header(strm);
-#endif
-                ((lzop_header*)(strm->header))->blocksize = 4 + 4 +
-                    ((((lzop_header*)(strm->header))->flags & F_ADLER32_D)?4:0) +
-                    ((((lzop_header*)(strm->header))->flags & F_CRC32_D)?4:0) +
-                    ((((lzop_header*)(strm->header))->flags & F_ADLER32_C)?4:0) +
-                    ((((lzop_header*)(strm->header))->flags & F_CRC32_C)?4:0) ;
-                ((lzop_data*)(strm->data))->insize = 0;
-                PD("Inflate blocksize: 0x%08lX\n", ((lzop_header*)(strm->header))->blocksize);
+            if (!((lzop_header*)(strm->header))->ready){
+                /* the header is not complete, wait for more input */
+                return LZOP_OK;
             }
         }
 
@@ -604,115 +1220,210 @@ LZOP_STATUS lzop_inflate(lzop_streamp strm){
             /* if the first int src_len == 0 the stream is finished */
             int fb_len = 0;
             if (((lzop_data*)(strm->data))->dst_len == 0){
-                if ((fb_len =_lzop_fillbuffer_in(strm, ((lzop_header*)(strm->header))->blocksize)) < ((lzop_header*)(strm->header))->blocksize){
-                    if (fb_len == 0){
-                        return LZOP_OK;
-                    }else{
-                        ((lzop_data*)(strm->data))->src_len = fromBe32(*(uint32_t*)(((lzop_data*)(strm->data))->inbuf));
-                        if (0 == ((lzop_data*)(strm->data))->src_len && 4 == fb_len){
-                            /* the end of the stream is reached */
-                            return LZOP_STREAM_END;
-                        }
-                        if (0 == ((lzop_data*)(strm->data))->src_len && fb_len > 4){
-                            /* the end of the stream is reached */
-                            return LZOP_STREAM_END;
-                        }
+                if (!_lzop_block_desc_fill(strm)){
+                    fb_len = ((lzop_data*)(strm->data))->insize;
+                    if (fb_len >= 4 && 0 == fromBe32(*(uint32_t*)(((lzop_data*)(strm->data))->inbuf))){
+                        /* the end of the stream is reached */
+                        return LZOP_STREAM_END;
                     }
-
-
+                    /* the descriptor is not complete, wait for more input */
+                    return LZOP_OK;
                 }else{
-                    size_t offset = 0;
-                    ((lzop_data*)(strm->data))->src_len = fromBe32(*(uint32_t*)(&((lzop_data*)(strm->data))->inbuf[offset]));
-                    offset += 4;
-                    ((lzop_data*)(strm->data))->dst_len = fromBe32(*(uint32_t*)(&((lzop_data*)(strm->data))->inbuf[offset]));
-                    offset += 4;
-                    if ((((lzop_header*)(strm->header))->flags & F_ADLER32_D)){
-                        ((lzop_data*)(strm->data))->src_adler32 = fromBe32(*(uint32_t*)(&((lzop_data*)(strm->data))->inbuf[offset]));
-                        offset += 4;
-                    }
-                    if ((((lzop_header*)(strm->header))->flags & F_CRC32_D)){
-                        ((lzop_data*)(strm->data))->src_crc32 = fromBe32(*(uint32_t*)(&((lzop_data*)(strm->data))->inbuf[offset]));
-                        offset += 4;
-                    }
-                    if ((((lzop_header*)(strm->header))->flags & F_ADLER32_C)){
-                        ((lzop_data*)(strm->data))->dst_adler32 = fromBe32(*(uint32_t*)(&((lzop_data*)(strm->data))->inbuf[offset]));
-                        offset += 4;
-                    }
-                    if ((((lzop_header*)(strm->header))->flags & F_CRC32_C)){
-                        ((lzop_data*)(strm->data))->dst_crc32 = fromBe32(*(uint32_t*)(&((lzop_data*)(strm->data))->inbuf[offset]));
-                        offset += 4;
-                    }
+                    _lzop_block_desc_read(strm);
                     ((lzop_data*)(strm->data))->insize = 0;
-                    PD("Inflate src_len: 0x%08X\n", ((lzop_data*)(strm->data))->src_len);
-                    PD("Inflate dst_len: 0x%08X\n", ((lzop_data*)(strm->data))->dst_len);
-                    PD("Inflate src_adler32: 0x%08X\n", ((lzop_data*)(strm->data))->src_adler32);
-                    PD("Inflate src_crc32: 0x%08X\n", ((lzop_data*)(strm->data))->src_crc32);
-                    PD("Inflate dst_adler32: 0x%08X\n", ((lzop_data*)(strm->data))->dst_adler32);
-                    PD("Inflate dst_crc32: 0x%08X\n", ((lzop_data*)(strm->data))->dst_crc32);
                     if (0 == ((lzop_data*)(strm->data))->src_len){
                         return LZOP_STREAM_END;
                     }
-                    if (((lzop_data*)(strm->data))->src_len > BLOCK_SIZE || ((lzop_data*)(strm->data))->dst_len > BLOCK_SIZE){
+                    if (((lzop_data*)(strm->data))->src_len > MAX_BLOCK_SIZE || ((lzop_data*)(strm->data))->dst_len > ((lzop_data*)(strm->data))->src_len){
                         return LZOP_CORRUPTED_DATA;
                     }
+                    /* nothing is pending in the buffers here, blocks larger than the default get bigger ones */
+                    if (!_lzop_buf_grow(&((lzop_data*)(strm->data))->inbuf, &((lzop_data*)(strm->data))->inbufsize, ((lzop_data*)(strm->data))->dst_len) ||
+                        !_lzop_buf_grow(&((lzop_data*)(strm->data))->outbuf, &((lzop_data*)(strm->data))->outbufsize, ((lzop_data*)(strm->data))->src_len)){
+                        return LZOP_ERROR;
+                    }
                 }
             }
 
             if (((lzop_data*)(strm->data))->dst_len != 0){
-                size_t inlen = ((lzop_data*)(strm->data))->dst_len < ((lzop_data*)(strm->data))->src_len ? ((lzop_data*)(strm->data))->dst_len : ((lzop_data*)(strm->data))->src_len ;
-                if (_lzop_fillbuffer_in(strm, inlen) < inlen){
+                lzop_data *data = (lzop_data*)(strm->data);
+                const uint8_t *in = data->inbuf;
+                uint8_t *out = data->outbuf;
+                int direct = strm->avail_out >= data->src_len;
+                if (0 == data->insize && strm->avail_in >= data->dst_len){
+                    /* the whole block is in the caller's buffer, decode it from there */
+                    in = strm->next_in;
+                    strm->next_in += data->dst_len;
+                    strm->avail_in -= data->dst_len;
+                }else if (_lzop_fillbuffer_in(strm, data->dst_len) < data->dst_len){
                     return LZOP_OK;
+                }
+                if (direct){
+                    /* and straight into next_out when it fits */
+                    out = strm->next_out + out_offset;
+                }
+                if (LZOP_OK != _lzop_block_verify_c((lzop_header*)(strm->header), &data->chk, in, data->dst_len, data->src_len) ||
+                    LZOP_OK != lzop_inflateBlock(in, data->dst_len, out, data->src_len) ||
+                    LZOP_OK != _lzop_block_verify_d((lzop_header*)(strm->header), &data->chk, out, data->src_len)){
+                    return LZOP_CORRUPTED_DATA;
+                }
+                if (direct){
+                    strm->avail_out -= data->src_len;
+                    out_offset += data->src_len;
                 }else{
-                    if (((lzop_data*)(strm->data))->dst_len < ((lzop_data*)(strm->data))->src_len){
-                        int r = lzo1x_decompress(((lzop_data*)(strm->data))->inbuf, ((lzop_data*)(strm->data))->dst_len, ((lzop_data*)(strm->data))->outbuf, &((lzop_data*)(strm->data))->outsize, NULL);
-                    }else{
-                        memcpy(((lzop_data*)(strm->data))->outbuf, ((lzop_data*)(strm->data))->inbuf, ((lzop_data*)(strm->data))->insize);
-                        ((lzop_data*)(strm->data))->outsize = ((lzop_data*)(strm->data))->insize;
-                    }
-                    ((lzop_data*)(strm->data))->insize = 0;
-                    ((lzop_data*)(strm->data))->dst_len = 0;
+                    data->outsize = data->src_len;
                 }
+                data->insize = 0;
+                data->dst_len = 0;
             }
         }
     }
     return LZOP_OK;
 }
 
+/*
+ * lzop - Block
+ *    uint32 - src_len (uncompressed data len)
+ *    uint32 - dst_len (compressed block size)
+ *    uint32 - src_chk (ADLER32 or CRC32, if any)
+ *    char[] - compressed block data
+ *
+ */
+static LZOP_STATUS _lzop_block_write(const lzop_header *header,
+        uint8_t *in, size_t insize, uint8_t *out, size_t *outsize, uint8_t *wrkmem){
+    lzo_uint dst_len;
+    size_t desc = (header->flags & (F_ADLER32_D | F_CRC32_D)) ? (3*4) : (2*4);
+    int ret;
+    switch (header->method){
+        case LZOP_M_LZO1X_1:
+            ret = lzo1x_1_compress(in, insize, out + desc, &dst_len, wrkmem);
+            break;
+        case LZOP_M_LZO1X_1_15:
+            ret = lzo1x_1_15_compress(in, insize, out + desc, &dst_len, wrkmem);
+            break;
+        default:
+            ret = lzo1x_999_compress_level(
+                in, insize,
+                out + desc, &dst_len,
+                wrkmem,
+                NULL, 0, 0, header->level);
+            break;
+    }
+    if(LZO_E_OK != ret){
+        return LZOP_ERROR;
+    }
+    if (dst_len >= insize){
+        /* stored, the decoders take dst_len == src_len as an uncompressed block */
+        dst_len = insize;
+        memcpy(out + desc, in, dst_len);
+    }
+    *(uint32_t*)(&out[0]) = toBe32(insize);
+    *(uint32_t*)(&out[4]) = toBe32(dst_len);
+    if (header->flags & F_ADLER32_D){
+        *(uint32_t*)(&out[8]) = toBe32(adler32(ADLER32_INIT_VALUE, in, insize));
+    }else if (header->flags & F_CRC32_D){
+        *(uint32_t*)(&out[8]) = toBe32(crc32(CRC32_INIT_VALUE, in, insize));
+    }
+    *outsize = desc + dst_len;
+    return LZOP_OK;
+}
+
+/*
+ * Multithreaded Deflate Workflow
+ *    --->  next_in, avail_in
+ *           \--> job[head+pending].inbuf (filled by the caller)
+ *                  \-> workers -> job[n].outbuf
+ *    <---  next_out, avail_out  <-- outbuf <-- job[head].outbuf (in order)
+ */
+static LZOP_STATUS _lzop_deflate_mt(lzop_streamp strm, LZOP_FLUSH_TYPE flush){
+    lzop_data *data = (lzop_data*)(strm->data);
+    lzop_pool *pool = data->pool;
+    size_t out_offset = 0;
+    while (1){
+        /* check if there are left bytes that can be copyed in the avail_out */
+        if (data->outsize){
+            out_offset = _lzop_drain_out(strm, out_offset);
+            if (data->outsize > 0){
+                return LZOP_OK;
+            }
+        }
+        if (S_DEF_END == data->state){
+            return LZOP_STREAM_END;
+        }
+        if (!((lzop_header*)(strm->header))->ready){
+            if (LZOP_OK != _lzop_header_write(strm)){
+                return LZOP_ERROR;
+            }
+            continue;
+        }
+        /* the oldest block goes out first, wait for it if there is nothing else to do */
+        if (pool->pending){
+            int wait = (pool->pending == pool->njobs) ||
+                       (LZOP_FLUSH == flush && 0 == strm->avail_in && 0 == data->insize);
+            switch (_lzop_pool_head(pool, wait)){
+                case J_FAILED:
+                    return LZOP_ERROR;
+                case J_DONE:
+                    data->outsize = _lzop_pool_pop(pool, &data->outbuf, &data->outbufsize)->outsize;
+                    continue;
+                default:
+                    break;
+            }
+        }
+        /* here at least one job is free, keep filling the current one */
+        data->inbuf = _lzop_pool_slot(pool)->inbuf;
+        _lzop_fillbuffer_in(strm, data->blksize);
+        if (data->insize == data->blksize ||
+            (LZOP_FLUSH == flush && 0 == strm->avail_in && data->insize > 0)){
+            _lzop_pool_slot(pool)->insize = data->insize;
+            _lzop_pool_submit(pool);
+            data->insize = 0;
+            continue;
+        }
+        if (LZOP_FLUSH == flush){
+            if (0 == pool->pending){
+                /* ENDFILE */
+                *(uint32_t*)(&data->outbuf[data->outpos + data->outsize]) = 0;
+                data->outsize += 4;
+                data->state = S_DEF_END;
+            }
+            continue;
+        }
+        return LZOP_OK;
+    }
+}
+
+/*
+ * Deflate Workflow
+ *    --->  next_in, avail_in
+ *           \--> inbuf, insize == block size (only if the block is split across calls)
+ *                  \-> deflate -> outbuf, outsize (only if next_out is too small)
+ *    <---  next_out, avail_out  <--/
+ */
+size_t lzop_deflateBound(lzop_streamp strm, size_t size){
+    size_t blksize = ((lzop_data*)(strm->data))->blksize;
+    size_t last = size % blksize;
+    return ZBUFSIZELZOP_HEADER + (size / blksize) * ZBUFSIZELZOP_BLOCK(blksize) +
+           (last ? ZBUFSIZELZOP_BLOCK(last) : 0) + 4 /* end of stream */;
+}
+
 LZOP_STATUS lzop_deflate(lzop_streamp strm, LZOP_FLUSH_TYPE flush){
+    if (((lzop_data*)(strm->data))->pool){
+        return _lzop_deflate_mt(strm, flush);
+    }
     size_t out_offset = 0;
     while(strm->avail_in > 0 || strm->avail_out > 0 ){
         /* check if there are left bytes that can be copyed in the avail_out */
-        if ( strm->avail_out > 0 && ((lzop_data*)(strm->data))->outsize ){
-            size_t toBeCopyed = ((lzop_data*)(strm->data))->outsize > strm->avail_out ? strm->avail_out : ((lzop_data*)(strm->data))->outsize;
-            memcpy(strm->next_out+out_offset, ((lzop_data*)(strm->data))->outbuf, toBeCopyed);
-#if 0
-            PD("Deflate 001 Copy: avail_out:%ld, outsize:%ld, tbc:%ld off: %lx - %02x %02x %02x %02x %02x %02x %02x %02x\n",
-                strm->avail_out, ((lzop_data*)(strm->data))->outsize,
-                toBeCopyed,
-                out_offset,
-                strm->next_out[out_offset+0],
-                strm->next_out[out_offset+1],
-                strm->next_out[out_offset+2],
-                strm->next_out[out_offset+3],
-                strm->next_out[out_offset+4],
-                strm->next_out[out_offset+5],
-                strm->next_out[out_offset+6],
-                strm->next_out[out_offset+7]
-                    );
-#endif
-            strm->avail_out -= toBeCopyed;
-            out_offset += toBeCopyed;
-            ((lzop_data*)(strm->data))->outsize -= toBeCopyed;
-            if(((lzop_data*)(strm->data))->outsize > 0){
-                memcpy(((lzop_data*)(strm->data))->outbuf, ((lzop_data*)(strm->data))->outbuf+toBeCopyed, ((lzop_data*)(strm->data))->outsize);
-            }
+        if ( ((lzop_data*)(strm->data))->outsize ){
+            out_offset = _lzop_drain_out(strm, out_offset);
 
+            /* do not stack a new block over the one still waiting to be copyed */
             if (strm->avail_out==0){
                 return LZOP_OK;
             }
-            if (LZOP_FLUSH == flush && ((lzop_data*)(strm->data))->outsize == 0 && ((lzop_data*)(strm->data))->insize == 0){
-                return LZOP_OK;
-            }
+        }
+        if (S_DEF_END == ((lzop_data*)(strm->data))->state){
+            return LZOP_STREAM_END;
         }
         //PD("Deflate 001 avail_in: %ld  h_ready: %d  dst_len: %d\n", strm->avail_in, ((lzop_header*)(strm->header))->ready, ((lzop_data*)(strm->data))->dst_len);
         /* phase 1, decode the header */
@@ -720,60 +1431,51 @@ LZOP_STATUS lzop_deflate(lzop_streamp strm, LZOP_FLUSH_TYPE flush){
             if (LZOP_OK != _lzop_header_write(strm)){
                 return LZOP_ERROR;
             }
+            /* out of the way of the first block */
+            out_offset = _lzop_drain_out(strm, out_offset);
         }
 
         if (((lzop_header*)(strm->header))->ready){
-            /*
-             * lzop - Block
-             *    uint32 - src_len (uncompressed data len)
-             *    uint32 - dst_len (compressed block size)
-             *    uint32 - src_chk (ADLER32 or CRC32)
-             *    char[] - compressed block data
-             *
-             */
-            /* if src_len / dst_len == 0 we need to retrieve the block header */
-            switch(flush){
-                case LZOP_FLUSH:
-                    _lzop_fillbuffer_in(strm, ((lzop_data*)(strm->data))->insize + strm->avail_in);
-                    break;
-                case LZOP_NO_FLUSH:
-                    if (((lzop_data*)(strm->data))->insize < ZBUFSIZELZOP_IN){
-                        if (_lzop_fillbuffer_in(strm, ZBUFSIZELZOP_IN) < ZBUFSIZELZOP_IN){
-                            return LZOP_OK;
-                        }
-                    }
-                    break;
+            lzop_data *data = (lzop_data*)(strm->data);
+            uint8_t *in = data->inbuf;
+            size_t insize;
+            if (0 == data->insize &&
+                (strm->avail_in >= data->blksize || (LZOP_FLUSH == flush && strm->avail_in > 0))){
+                /* a whole block is in the caller's buffer, compress it from there */
+                in = strm->next_in;
+                insize = strm->avail_in < data->blksize ? strm->avail_in : data->blksize;
+                strm->next_in += insize;
+                strm->avail_in -= insize;
+            }else{
+                insize = _lzop_fillbuffer_in(strm, data->blksize);
+                if (LZOP_NO_FLUSH == flush && insize < data->blksize){
+                    return LZOP_OK;
+                }
             }
 
-            if (LZOP_FLUSH == flush || ((lzop_data*)(strm->data))->insize == ZBUFSIZELZOP_IN){
+            if (insize == data->blksize || (LZOP_FLUSH == flush && insize > 0)){
                 size_t outsize;
-                if(LZO_E_OK != lzo1x_999_compress_level(
-                            ((lzop_data*)(strm->data))->inbuf,   ((lzop_data*)(strm->data))->insize,
-                            ((lzop_data*)(strm->data))->outbuf + ((lzop_data*)(strm->data))->outsize+(3*4), &outsize,
-                            ((lzop_data*)(strm->data))->wrkmem,
-                            NULL, 0, 0, ((lzop_header*)(strm->header))->level)){
+                /* and straight into next_out when nothing is pending and the worst case fits */
+                int direct = 0 == data->outsize && strm->avail_out >= ZBUFSIZELZOP_BLOCK(insize);
+                uint8_t *out = direct ? strm->next_out + out_offset : data->outbuf + data->outpos + data->outsize;
+                if (LZOP_OK != _lzop_block_write((lzop_header*)(strm->header),
+                            in, insize, out, &outsize, data->wrkmem)){
                     return LZOP_ERROR;
                 }
-                if (outsize > ((lzop_data*)(strm->data))->insize){
-                    outsize = ((lzop_data*)(strm->data))->insize;
-                    memcpy(((lzop_data*)(strm->data))->outbuf + ((lzop_data*)(strm->data))->outsize+(3*4), ((lzop_data*)(strm->data))->inbuf, outsize);
-                }
-                ((lzop_data*)(strm->data))->src_adler32 = lzo_adler32(ADLER32_INIT_VALUE, (lzo_bytep)((lzop_data*)(strm->data))->inbuf, ((lzop_data*)(strm->data))->insize);
-                *(uint32_t*)(&((lzop_data*)(strm->data))->outbuf[((lzop_data*)(strm->data))->outsize]) = toBe32(((lzop_data*)(strm->data))->insize);
-                ((lzop_data*)(strm->data))->outsize += 4;
-                *(uint32_t*)(&((lzop_data*)(strm->data))->outbuf[((lzop_data*)(strm->data))->outsize]) = toBe32(outsize);
-                ((lzop_data*)(strm->data))->outsize += 4;
-                *(uint32_t*)(&((lzop_data*)(strm->data))->outbuf[((lzop_data*)(strm->data))->outsize]) = toBe32(((lzop_data*)(strm->data))->src_adler32);
-                ((lzop_data*)(strm->data))->outsize += 4;
-                //memcpy(&((lzop_data*)(strm->data))->outbuf[((lzop_data*)(strm->data))->outsize], ((lzop_data*)(strm->data))->outbuf, outsize);
-                PD("Deflate 010, insize :%ld, outsize:%ld\n", ((lzop_data*)(strm->data))->insize, outsize);
-                ((lzop_data*)(strm->data))->outsize += outsize;
-                ((lzop_data*)(strm->data))->insize = 0;
-                if (LZOP_FLUSH == flush){
-                    /* ENDFILE */
-                    *(uint32_t*)(&((lzop_data*)(strm->data))->outbuf[((lzop_data*)(strm->data))->outsize]) = 0;
-                    ((lzop_data*)(strm->data))->outsize += 4;
+                PD("Deflate 010, insize :%ld, outsize:%ld\n", insize, outsize);
+                if (direct){
+                    strm->avail_out -= outsize;
+                    out_offset += outsize;
+                }else{
+                    data->outsize += outsize;
                 }
+                data->insize = 0;
+            }
+            if (LZOP_FLUSH == flush && 0 == strm->avail_in && 0 == data->insize){
+                /* ENDFILE */
+                *(uint32_t*)(&data->outbuf[data->outpos + data->outsize]) = 0;
+                data->outsize += 4;
+                data->state = S_DEF_END;
             }
         }
     }
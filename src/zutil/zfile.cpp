@@ -35,8 +35,16 @@
 #define PD(_d) do {;}while(0)
 #endif
 
-//ZFile::ZFile(){}
-//ZFile::~ZFile(){}
+ZFile::ZFile(): io(nullptr), mode(std::ios_base::app){}
+
+ZFile::~ZFile(){
+    delete this->io;
+}
+
+void ZFile::setIO(ZIO *io){
+    delete this->io;
+    this->io = io;
+}
 
 void ZFile::open(const char* filename, std::ios_base::openmode mode){
     PD("D [open]");
@@ -52,14 +60,36 @@ void ZFile::open(const char* filename, std::ios_base::openmode mode){
             return;
     }
     this->mode = mode;
-    this->fs.open (filename, mode | std::ios_base::binary);
+    this->filename = filename;
+    if (nullptr == this->io){
+        this->io = new ZIOStream();
+    }
+    if (!this->io->open(filename, mode)){
+        std::cerr << "Error opening " << filename << "\n";
+    }
 }
 
 void ZFile::close(){
     PD("D [close]");
-    this->fs.close();
+    if (nullptr == this->io){
+        /* never opened */
+        return;
+    }
+    this->io->close();
+}
+
+/* next chunk of the compressed file, straight from the backend when it is mapped */
+size_t ZFile::input(uint8_t* buf, size_t n, const uint8_t** next){
+    if (this->io->mappable()){
+        return this->io->map((const char**)next, n);
+    }
+    *next = buf;
+    return this->io->read((char*)buf, n);
 }
 
 bool ZFile::eof() const{
-    return this->fs.eof();
+    if (nullptr == this->io){
+        return true;
+    }
+    return this->io->eof();
 }
@@ -0,0 +1,191 @@
+/* zfileasync.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <iostream>
+#include <cstring>
+
+#include <zutil/zfileasync.h>
+
+// #define DEBUG
+
+#ifdef DEBUG
+#define PD(_d) do { std::cout << " #(async) " << _d ;}while(0)
+#else
+#define PD(_d) do {;}while(0)
+#endif
+
+ZFileAsync::ZFileAsync(ZFile *zf, const ZFileAsync::options &opt)
+    : zf(zf), opt(opt), pool(nullptr), queued(0), failed(false)
+{
+    this->mode = std::ios_base::app;
+    if (this->opt.chunk_size == 0){
+        this->opt.chunk_size = 1;
+    }
+};
+
+ZFileAsync::ZFileAsync(ZFile *zf)
+    : zf(zf), pool(nullptr), queued(0), failed(false)
+{
+    this->mode = std::ios_base::app;
+};
+
+ZFileAsync::~ZFileAsync(){
+    try {
+        this->close();
+    } catch (...) {
+        /* nobody left to report it to */
+    }
+    delete this->zf;
+};
+
+void ZFileAsync::open(const char* filename, std::ios_base::openmode mode){
+    this->mode = mode;
+    this->filename = filename;
+    this->zf->open(filename, mode);
+    if (mode == std::ios_base::out){
+        this->pool = new ZThreadPool(1);
+        this->queued = 0;
+        this->failed = false;
+        this->error = nullptr;
+    }
+}
+
+void ZFileAsync::close(){
+    if (this->mode == std::ios_base::app){
+        /* not open */
+        return;
+    }
+    this->mode = std::ios_base::app;
+    if (nullptr == this->pool){
+        this->zf->close();
+        return;
+    }
+    if (!this->failed){
+        this->flush();
+    }
+    while (!this->jobs.empty()){
+        this->reap();
+    }
+    delete this->pool;
+    this->pool = nullptr;
+    this->current.reset();
+    if (this->error){
+        std::exception_ptr error = this->error;
+        this->error = nullptr;
+        try {
+            this->zf->close();
+        } catch (...) {
+        }
+        std::rethrow_exception(error);
+    }
+    this->zf->close();
+}
+
+/* wait for the oldest chunk */
+void ZFileAsync::reap(){
+    job &j = this->jobs.front();
+    try {
+        j.done.get();
+    } catch (...) {
+        if (!this->error){
+            this->error = std::current_exception();
+        }
+        this->failed = true;
+    }
+    this->queued -= j.size;
+    this->jobs.pop_front();
+}
+
+/* hand the current chunk to the background thread */
+void ZFileAsync::flush(){
+    if (!this->current || this->current->empty()){
+        return;
+    }
+    size_t size = this->current->size();
+    /* back pressure, and pick up the chunks already written */
+    while (!this->jobs.empty() &&
+           (this->queued + size > this->opt.max_queued ||
+            std::future_status::ready == this->jobs.front().done.wait_for(std::chrono::seconds(0)))){
+        this->reap();
+    }
+    if (this->error){
+        std::rethrow_exception(this->error);
+    }
+    std::shared_ptr<std::vector<char>> buf(this->current.release());
+    PD("D [flush] size:"<<size<<" queued:"<<this->queued<<std::endl);
+    job j;
+    j.size = size;
+    j.done = this->pool->submit([this, buf]{
+        /* gz and lzo report a failed write with a short count, not an exception */
+        if (!this->failed && this->zf->write(buf->data(), buf->size()) != buf->size()){
+            std::cerr << "Deflate error: short write of " << buf->size() << " bytes" << std::endl;
+            throw "Deflate Error!";
+        }
+    });
+    this->jobs.push_back(std::move(j));
+    this->queued += size;
+}
+
+size_t ZFileAsync::write (const char* s, size_t n){
+    if (nullptr == this->pool){
+        return 0;
+    }
+    if (this->error){
+        std::rethrow_exception(this->error);
+    }
+    size_t s_offset = 0;
+    while (s_offset < n){
+        if (!this->current){
+            this->current.reset(new std::vector<char>());
+            this->current->reserve(this->opt.chunk_size);
+        }
+        size_t copy_size = this->opt.chunk_size - this->current->size();
+        copy_size = copy_size > n - s_offset ? n - s_offset : copy_size;
+        this->current->insert(this->current->end(), s + s_offset, s + s_offset + copy_size);
+        s_offset += copy_size;
+        if (this->current->size() == this->opt.chunk_size){
+            this->flush();
+        }
+    }
+    return n;
+}
+
+size_t ZFileAsync::read (char* s, size_t n){
+    return this->zf->read(s, n);
+}
+
+size_t ZFileAsync::peek (const char** s){
+    return this->zf->peek(s);
+}
+
+void ZFileAsync::consume (size_t n){
+    this->zf->consume(n);
+}
+
+bool ZFileAsync::eof() const{
+    return this->zf->eof();
+}
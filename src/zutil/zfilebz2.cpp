@@ -0,0 +1,812 @@
+/* zfilebz2.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <iostream>
+#include <cstring>
+#include <climits>
+#include <array>
+#include <thread>
+
+#include <zutil/zfilebz2.h>
+
+#ifdef TEST_BUFFER
+#define ZBUFSIZEBZ2 ( TEST_BUFFER )
+#else
+#define ZBUFSIZEBZ2 (0x1000 * 0x80) /* 512k */
+#endif
+
+// #define DEBUG
+
+#ifdef DEBUG
+#define PD(_d) do { std::cout << " #(bz2) " << _d ;}while(0)
+#else
+#define PD(_d) do {;}while(0)
+#endif
+
+/* 48 bit magics starting each block and the end of each stream, not byte aligned */
+#define ZBZ2_BLOCK_MAGIC 0x314159265359ULL
+#define ZBZ2_EOS_MAGIC   0x177245385090ULL
+#define ZBZ2_MAGIC_MASK  0xffffffffffffULL
+#define ZBZ2_NONE        UINT64_MAX
+
+/* n bits (up to 32) from bit offset bit, msb first as bzip2 writes them */
+static uint32_t getBits(const uint8_t *buf, uint64_t bit, int n){
+    uint32_t v = 0;
+    for (int i = 0; i < n; i++, bit++){
+        v = (v << 1) | ((buf[bit >> 3] >> (7 - (bit & 7))) & 1);
+    }
+    return v;
+}
+
+/*
+ * For each byte, the shifts at which it can be the byte before the last
+ * one of a magic: the magic search only looks closer at those.
+ */
+static const std::array<uint8_t, 256> &magicFilter(){
+    static const std::array<uint8_t, 256> filter = []{
+        std::array<uint8_t, 256> f = {};
+        for (int k = 0; k < 8; k++){
+            f[((ZBZ2_BLOCK_MAGIC << k) >> 8) & 0xff] |= 1 << k;
+            f[((ZBZ2_EOS_MAGIC << k) >> 8) & 0xff] |= 1 << k;
+        }
+        return f;
+    }();
+    return filter;
+}
+
+/* the stream crc combines the block crcs in order */
+static uint32_t crcCombine(uint32_t combined, uint32_t crc){
+    return ((combined << 1) | (combined >> 31)) ^ crc;
+}
+
+ZFileBZ2::ZFileBZ2(const ZFileBZ2::options &opt)
+    : strm(), inbuf(nullptr), outbuf(nullptr), outdata(nullptr), outsize(0), offsetbuf(0),
+      status(BZ_OK), end(false), opt(opt), pool(nullptr), streams(0), pos(0)
+{
+    this->inbuf = new uint8_t[ZBUFSIZEBZ2];
+    this->outbuf = new uint8_t[ZBUFSIZEBZ2];
+    this->outdata = this->outbuf;
+}
+
+ZFileBZ2::ZFileBZ2()
+    : strm(), inbuf(nullptr), outbuf(nullptr), outdata(nullptr), outsize(0), offsetbuf(0),
+      status(BZ_OK), end(false), pool(nullptr), streams(0), pos(0)
+{
+    this->inbuf = new uint8_t[ZBUFSIZEBZ2];
+    this->outbuf = new uint8_t[ZBUFSIZEBZ2];
+    this->outdata = this->outbuf;
+}
+
+ZFileBZ2::~ZFileBZ2(){
+    /* join the workers before the blocks they use go away */
+    if (this->pool)   delete this->pool;
+    /* left open by an error */
+    if (this->strm.state && this->mode == std::ios_base::in)  BZ2_bzDecompressEnd(&this->strm);
+    if (this->strm.state && this->mode == std::ios_base::out) BZ2_bzCompressEnd(&this->strm);
+    if (this->inbuf)  delete[] this->inbuf;
+    if (this->outbuf) delete[] this->outbuf;
+}
+
+void ZFileBZ2::open(const char* filename, std::ios_base::openmode mode){
+    ZFile::open(filename, mode);
+    uint32_t threads = this->opt.threads;
+    if (0 == threads){
+        threads = std::thread::hardware_concurrency();
+    }
+    this->offsetbuf = 0;
+    this->outdata = this->outbuf;
+    this->outsize = 0;
+    this->streams = 0;
+    if (this->mode == std::ios_base::in && threads > 1){
+        /*
+         * The blocks are found by their magic, cut out and decoded by the
+         * pool, each one wrapped in a stream of its own; a magic showing
+         * up inside the compressed data only costs joining the two halves.
+         */
+        this->pool = new ZThreadPool(threads);
+        this->end = false;
+        this->pos = 0;
+        this->raw.clear();
+        this->rawbase = 0;
+        this->scan = 0;
+        this->window = 0;
+        this->lowbit = 0;
+        this->blockstart = ZBZ2_NONE;
+        this->streamstart = 0;
+        this->header = true;
+        this->parsed = false;
+        this->hcrc = 0;
+        this->combined = 0;
+        return;
+    }
+    if (this->mode == std::ios_base::in){
+        std::memset(&this->strm, 0, sizeof(this->strm));
+        this->status = BZ2_bzDecompressInit(&this->strm, 0, 0);
+        if (BZ_OK != this->status){
+            std::cerr << "Error initializing the decoder: " << this->status << std::endl;
+            throw "Decoder Not initialized!";
+        }
+        this->end = false;
+        this->pos = 0;
+    }
+    if (this->mode == std::ios_base::out && threads > 1){
+        /*
+         * pbzip2 style: each chunk is compressed as a whole bzip2 stream,
+         * the streams are written one after the other in a standard
+         * multi-stream file.
+         */
+        this->pool = new ZThreadPool(threads);
+        this->current.reset(new block);
+        return;
+    }
+    if (this->mode == std::ios_base::out){
+        std::memset(&this->strm, 0, sizeof(this->strm));
+        int ret = BZ2_bzCompressInit(&this->strm, this->opt.level, 0, this->opt.work_factor);
+        if (BZ_OK != ret){
+            std::cerr << "Error initializing the encoder: " << ret << std::endl;
+            throw "Encoder Not initialized!";
+        }
+    }
+}
+
+void ZFileBZ2::close(){
+    if (this->mode == std::ios_base::out && this->pool){
+        /* an empty file is still an (empty) stream */
+        if (!this->current->in.empty() || 0 == this->streams){
+            this->submitBlock();
+        }
+        this->drainBlocks(true);
+        delete this->pool;
+        this->pool = nullptr;
+        this->current.reset();
+        PD("D [close](out) parallel streams:"<<this->streams<<std::endl);
+    }else if (this->mode == std::ios_base::out){
+        int ret;
+        do {
+            this->strm.next_out = (char*)this->outbuf;
+            this->strm.avail_out = ZBUFSIZEBZ2;
+            ret = BZ2_bzCompress(&this->strm, BZ_FINISH);
+            if (ret < 0){
+                std::cerr << "Deflate error: " << ret << std::endl;
+                throw "Deflate Error!";
+            }
+            if (this->strm.avail_out != ZBUFSIZEBZ2){
+                this->io->write((char*)(this->outbuf), ZBUFSIZEBZ2 - this->strm.avail_out);
+            }
+        } while (BZ_STREAM_END != ret);
+        BZ2_bzCompressEnd(&this->strm);
+        PD("D [close](out)"<<std::endl);
+    }else if (this->pool){
+        /* the queued blocks are dropped, the running ones waited */
+        delete this->pool;
+        this->pool = nullptr;
+        this->blocks.clear();
+        this->raw.clear();
+        PD("D [close](in) parallel"<<std::endl);
+    }else{
+        BZ2_bzDecompressEnd(&this->strm);
+        PD("D [close](in)"<<std::endl);
+    }
+    ZFile::close();
+}
+
+size_t ZFileBZ2::write (const char* s, size_t n){
+    if (this->mode != std::ios_base::out){
+        // Error, Not possible to read here
+        return 0;
+    }
+    if (this->pool){
+        return this->writeParallel(s, n);
+    }
+    size_t s_offset = 0;
+
+    /* BZ2_bzCompress reads straight from the caller's buffer */
+    while (0 != n) {
+        unsigned int chunk_size = n > UINT_MAX ? UINT_MAX : n;
+        this->strm.next_in = (char*)(s + s_offset);
+        this->strm.avail_in = chunk_size;
+
+        while (this->strm.avail_in){
+            this->strm.next_out = (char*)this->outbuf;
+            this->strm.avail_out = ZBUFSIZEBZ2;
+            int ret = BZ2_bzCompress(&this->strm, BZ_RUN);
+            PD("D 010 ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+            if (BZ_RUN_OK != ret){
+                std::cerr << "Deflate error: " << ret << std::endl;
+                throw "Deflate Error!";
+            }
+            if (this->strm.avail_out != ZBUFSIZEBZ2){
+                this->io->write((char*)(this->outbuf), ZBUFSIZEBZ2 - this->strm.avail_out);
+            }
+        }
+        s_offset += chunk_size;
+        n -= chunk_size;
+    }
+    return s_offset;
+}
+
+size_t ZFileBZ2::writeParallel (const char* s, size_t n){
+    size_t block_size = this->opt.block_size ? this->opt.block_size : this->opt.level * 100000;
+    size_t s_offset = 0;
+    while (0 != n) {
+        std::vector<uint8_t> &in = this->current->in;
+        size_t copy_size = block_size - in.size();
+        copy_size = copy_size > n ? n : copy_size;
+        in.insert(in.end(), (const uint8_t*)s + s_offset, (const uint8_t*)s + s_offset + copy_size);
+        s_offset += copy_size;
+        n -= copy_size;
+        if (in.size() == block_size){
+            this->submitBlock();
+            this->drainBlocks(false);
+            this->current.reset(new block);
+        }
+    }
+    return s_offset;
+}
+
+void ZFileBZ2::submitBlock(){
+    block *b = this->current.release();
+    const ZFileBZ2::options &opt = this->opt;
+    b->done = this->pool->submit([b, opt]{ ZFileBZ2::deflateBlock(b, opt); });
+    this->blocks.emplace_back(b);
+    this->streams++;
+}
+
+/*
+ * Write the finished streams in order; unless all is requested only the
+ * ones already done are written, waiting just when too many are queued.
+ */
+void ZFileBZ2::drainBlocks(bool all){
+    while (!this->blocks.empty()){
+        block *b = this->blocks.front().get();
+        if (!all && this->blocks.size() <= 2 * this->pool->size() &&
+            std::future_status::ready != b->done.wait_for(std::chrono::seconds(0))){
+            return;
+        }
+        b->done.get(); /* rethrow the worker errors */
+        this->io->write((const char*)b->out.data(), b->out.size());
+        PD("D drain in:"<<b->in.size()<<" out:"<<b->out.size()<<std::endl);
+        this->blocks.pop_front();
+    }
+}
+
+void ZFileBZ2::deflateBlock(block *b, const ZFileBZ2::options &opt){
+    char empty = 0;
+    unsigned int size = b->in.size() + b->in.size() / 100 + 600;
+    b->out.resize(size);
+    int ret = BZ2_bzBuffToBuffCompress((char*)b->out.data(), &size,
+                                       b->in.empty() ? &empty : (char*)b->in.data(), b->in.size(),
+                                       opt.level, 0, opt.work_factor);
+    if (BZ_OK != ret){
+        throw "Deflate Error!";
+    }
+    b->out.resize(size);
+}
+
+std::vector<char> ZFileBZ2::compress(const char* s, size_t n, const ZFileBZ2::options &opt){
+    bz_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (BZ_OK != BZ2_bzCompressInit(&zs, opt.level, 0, opt.work_factor)){
+        std::cerr << "Error initializing the encoder" << std::endl;
+        throw "Encoder Not initialized!";
+    }
+    /* the BZ2_bzBuffToBuffCompress() bound, the counters are unsigned int */
+    std::vector<char> out(n + n / 100 + 600);
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    int ret;
+    do {
+        size_t in_size = n - in_pos > UINT_MAX ? UINT_MAX : n - in_pos;
+        size_t out_size = out.size() - out_pos > UINT_MAX ? UINT_MAX : out.size() - out_pos;
+        zs.next_in = (char*)s + in_pos;
+        zs.avail_in = in_size;
+        zs.next_out = out.data() + out_pos;
+        zs.avail_out = out_size;
+        ret = BZ2_bzCompress(&zs, n - in_pos == in_size ? BZ_FINISH : BZ_RUN);
+        in_pos += in_size - zs.avail_in;
+        out_pos += out_size - zs.avail_out;
+    } while ((BZ_RUN_OK == ret || BZ_FINISH_OK == ret) && out_pos < out.size());
+    BZ2_bzCompressEnd(&zs);
+    if (BZ_STREAM_END != ret){
+        std::cerr << "Deflate error: " << ret << std::endl;
+        throw "Deflate Error!";
+    }
+    out.resize(out_pos);
+    PD("D [compress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+std::vector<char> ZFileBZ2::decompress(const char* s, size_t n){
+    bz_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    int ret = BZ2_bzDecompressInit(&zs, 0, 0);
+    if (BZ_OK != ret){
+        std::cerr << "Error initializing the decoder: " << ret << std::endl;
+        throw "Decoder Not initialized!";
+    }
+    /* no size in the stream, the output grows */
+    std::vector<char> out(2 * n > ZBUFSIZEBZ2 ? 2 * n : ZBUFSIZEBZ2);
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    uint32_t streams = 0;
+    bool stalled = false;
+    while (true){
+        if (out_pos == out.size()){
+            out.resize(out.size() * 2);
+        }
+        size_t in_size = n - in_pos > UINT_MAX ? UINT_MAX : n - in_pos;
+        size_t out_size = out.size() - out_pos > UINT_MAX ? UINT_MAX : out.size() - out_pos;
+        zs.next_in = (char*)s + in_pos;
+        zs.avail_in = in_size;
+        zs.next_out = out.data() + out_pos;
+        zs.avail_out = out_size;
+        ret = BZ2_bzDecompress(&zs);
+        in_pos += in_size - zs.avail_in;
+        out_pos += out_size - zs.avail_out;
+        stalled = in_size == zs.avail_in && out_size == zs.avail_out;
+        if (BZ_STREAM_END == ret){
+            streams++;
+        }
+        if (BZ_STREAM_END == ret && in_pos < n){
+            /* concatenated streams, pbzip2 writes one per chunk */
+            BZ2_bzDecompressEnd(&zs);
+            std::memset(&zs, 0, sizeof(zs));
+            ret = BZ2_bzDecompressInit(&zs, 0, 0);
+            if (BZ_OK != ret){
+                std::cerr << "Error initializing the decoder: " << ret << std::endl;
+                throw "Decoder Not initialized!";
+            }
+            continue;
+        }
+        if (BZ_DATA_ERROR_MAGIC == ret && streams){
+            /* trailing garbage is ignored, as bzip2 does */
+            ret = BZ_STREAM_END;
+        }
+        if (BZ_OK != ret || stalled){
+            break;
+        }
+    }
+    BZ2_bzDecompressEnd(&zs);
+    if (BZ_OK == ret){
+        std::cerr << "Inflate error: truncated input" << std::endl;
+        throw "Inflate Error!";
+    }
+    if (BZ_STREAM_END != ret){
+        std::cerr << "Inflate error: " << ret << std::endl;
+        throw "Inflate Error!";
+    }
+    out.resize(out_pos);
+    PD("D [decompress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+/*
+ * Decode a block cut out of a stream: it is realigned to a byte and
+ * wrapped between a stream header and an end of stream marker whose
+ * combined crc is just the block crc. ok is false when the block does
+ * not decode, most likely because it has been cut short.
+ */
+void ZFileBZ2::inflateBlock(block *b){
+    size_t nbytes = b->bits / 8;
+    std::vector<uint8_t> s;
+    s.reserve(nbytes + 16);
+    s.push_back('B');
+    s.push_back('Z');
+    s.push_back('h');
+    s.push_back(b->level);
+    if (0 == b->shift){
+        s.insert(s.end(), b->in.begin(), b->in.begin() + nbytes);
+    }else{
+        for (size_t i = 0; i < nbytes; i++){
+            s.push_back((b->in[i] << b->shift) | (b->in[i + 1] >> (8 - b->shift)));
+        }
+    }
+    uint32_t acc = 0;
+    int accbits = 0;
+    auto put = [&](uint64_t v, int n){
+        while (n--){
+            acc = (acc << 1) | ((v >> n) & 1);
+            if (8 == ++accbits){
+                s.push_back(acc);
+                acc = 0;
+                accbits = 0;
+            }
+        }
+    };
+    put(getBits(b->in.data(), nbytes * 8 + b->shift, b->bits % 8), b->bits % 8);
+    put(ZBZ2_EOS_MAGIC, 48);
+    put(b->crc, 32);
+    if (accbits){
+        s.push_back(acc << (8 - accbits));
+    }
+
+    bz_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (BZ_OK != BZ2_bzDecompressInit(&zs, 0, 0)){
+        throw "Decoder Not initialized!";
+    }
+    size_t have = 0;
+    b->out.resize(100000 * (b->level - '0'));
+    zs.next_in = (char*)s.data();
+    zs.avail_in = s.size();
+    b->ok = false;
+    while (true) {
+        zs.next_out = (char*)b->out.data() + have;
+        zs.avail_out = b->out.size() - have;
+        int ret = BZ2_bzDecompress(&zs);
+        have = b->out.size() - zs.avail_out;
+        if (BZ_STREAM_END == ret){
+            b->ok = true;
+            break;
+        }
+        if (BZ_OK != ret || (0 == zs.avail_in && 0 != zs.avail_out)){
+            break;
+        }
+        if (0 == zs.avail_out){
+            /* runs shrunk by the first rle stage */
+            b->out.resize(b->out.size() * 2);
+        }
+    }
+    BZ2_bzDecompressEnd(&zs);
+    b->out.resize(have);
+}
+
+size_t ZFileBZ2::read (char* s, size_t n){
+    if (this->mode != std::ios_base::in){
+        // Error, Not possible to write here
+        return 0;
+    }
+
+    size_t s_offset = 0;
+
+    while (true) {
+        /*
+         *  this->outdata   = [xxxxxxxxxx------]
+         *  this->outsize              ^
+         *  this->offsetbuf      ^
+         */
+        size_t out_size = this->outsize - this->offsetbuf;
+        size_t copy_size = out_size > n ? n : out_size;
+
+        std::memcpy(s + s_offset, this->outdata + this->offsetbuf, copy_size);
+
+        this->offsetbuf += copy_size;
+        s_offset += copy_size;
+        n -= copy_size;
+
+        PD("D 001 eof:"<<this->io->eof()<<" out_size:"<<out_size
+           <<" copy_size:"<<copy_size<<" s_offset:"<<s_offset<<std::endl);
+
+        if (0 == n){
+            this->pos += s_offset;
+            return s_offset;
+        }
+        if (n >= ZBUFSIZEBZ2 && !this->pool){
+            /* the outbuf is empty, large reads are decoded straight into s */
+            bool more = this->fill((uint8_t*)s + s_offset, n);
+            size_t direct_size = this->outsize;
+            this->outdata = this->outbuf;
+            this->outsize = 0;
+            s_offset += direct_size;
+            n -= direct_size;
+            if (!more){
+                this->pos += s_offset;
+                return s_offset;
+            }
+        }else if (!this->fill()){
+            this->pos += s_offset;
+            return s_offset;
+        }
+    }
+}
+
+/* the outbuf is empty, decode the next chunk; false when nothing else can be decoded */
+bool ZFileBZ2::fill(){
+    if (this->pool){
+        return this->fillParallel();
+    }
+    return this->fill(this->outbuf, ZBUFSIZEBZ2);
+}
+
+/* decode into out, either the outbuf or the caller's buffer */
+bool ZFileBZ2::fill(uint8_t *out, size_t size){
+    this->offsetbuf = 0;
+    this->outdata = out;
+    this->outsize = 0;
+    if (this->end){
+        return false;
+    }
+
+    if (0 == this->strm.avail_in && !this->io->eof()) {
+        const uint8_t *next;
+        // read data as a block:
+        this->strm.avail_in = this->input(this->inbuf, ZBUFSIZEBZ2, &next);
+        this->strm.next_in = (char*)next;
+        PD("D 004 eof:"<<this->io->eof()<<" avail_in:"<<this->strm.avail_in<<std::endl);
+    }
+
+    if (BZ_STREAM_END == this->status){
+        /* concatenated streams, pbzip2 writes one per chunk */
+        if (0 == this->strm.avail_in && this->io->eof()){
+            this->end = true;
+            return false;
+        }
+        char *next_in = this->strm.next_in;
+        unsigned int avail_in = this->strm.avail_in;
+        BZ2_bzDecompressEnd(&this->strm);
+        std::memset(&this->strm, 0, sizeof(this->strm));
+        this->status = BZ2_bzDecompressInit(&this->strm, 0, 0);
+        if (BZ_OK != this->status){
+            std::cerr << "Error initializing the decoder: " << this->status << std::endl;
+            throw "Decoder Not initialized!";
+        }
+        this->strm.next_in = next_in;
+        this->strm.avail_in = avail_in;
+    }
+
+    unsigned int avail_out = size > UINT_MAX ? UINT_MAX : size;
+    this->strm.next_out = (char*)out;
+    this->strm.avail_out = avail_out;
+    int ret = BZ2_bzDecompress(&this->strm);
+    this->outsize = avail_out - this->strm.avail_out;
+    PD("D 010 eof:"<<this->io->eof()<<" ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" outsize:"<<this->outsize<<std::endl);
+    if (BZ_DATA_ERROR_MAGIC == ret && this->streams){
+        /* trailing garbage is ignored, as bzip2 does */
+        this->end = true;
+        return false;
+    }
+    if (BZ_OK != ret && BZ_STREAM_END != ret){
+        std::cerr << "Inflate error: " << ret << std::endl;
+        throw "Inflate Error!";
+    }
+    if (BZ_STREAM_END == ret){
+        this->status = ret;
+        this->streams++;
+    }else if (0 == this->outsize && 0 == this->strm.avail_in && this->io->eof()){
+        /* the file ends inside a stream, as bzip2 does this is an error */
+        std::cerr << "Inflate error: truncated input" << std::endl;
+        throw "Inflate Error!";
+    }
+    return true;
+}
+
+/* the next decoded block, in order; false when nothing else can be decoded */
+bool ZFileBZ2::fillParallel(){
+    this->offsetbuf = 0;
+    this->outsize = 0;
+    while (true) {
+        /* keep the workers busy */
+        while (this->blocks.size() < 2 * this->pool->size() && this->splitBlocks());
+        if (this->blocks.empty()){
+            return false;
+        }
+        block *b = this->blocks.front().get();
+        if (b->eos){
+            if (b->crc != this->combined){
+                std::cerr << "Inflate error: stream crc mismatch" << std::endl;
+                throw "Inflate Error!";
+            }
+            this->combined = 0;
+            this->blocks.pop_front();
+            continue;
+        }
+        b->done.get(); /* rethrow the worker errors */
+        while (!b->ok){
+            /* a magic found in the compressed data cut the block, join the next piece */
+            if (this->blocks.size() < 2){
+                this->splitBlocks();
+            }
+            if (this->blocks.size() < 2 || this->blocks[1]->eos){
+                std::cerr << "Inflate error: block does not decode" << std::endl;
+                throw "Inflate Error!";
+            }
+            block *next = this->blocks[1].get();
+            next->done.get();
+            PD("D join bits:"<<b->bits<<" + "<<next->bits<<std::endl);
+            b->in.resize((b->shift + b->bits) / 8);
+            b->in.insert(b->in.end(), next->in.begin(), next->in.end());
+            b->bits += next->bits;
+            this->blocks.erase(this->blocks.begin() + 1);
+            ZFileBZ2::inflateBlock(b);
+        }
+        this->combined = crcCombine(this->combined, b->crc);
+        this->blockout.swap(b->out);
+        this->blocks.pop_front();
+        this->outdata = this->blockout.data();
+        this->outsize = this->blockout.size();
+        if (this->outsize){
+            return true;
+        }
+    }
+}
+
+/* search the magics and queue the blocks found; false when nothing else can be split */
+bool ZFileBZ2::splitBlocks(){
+    size_t queued = this->blocks.size();
+    while (!this->parsed && this->blocks.size() == queued){
+        uint64_t avail = this->rawbase + this->raw.size();
+        if (this->header){
+            if (avail < this->streamstart + 4 && !this->io->eof()){
+                this->readRaw();
+                continue;
+            }
+            const uint8_t *h = this->raw.data() + (this->streamstart - this->rawbase);
+            if (avail < this->streamstart + 4 ||
+                'B' != h[0] || 'Z' != h[1] || 'h' != h[2] || h[3] < '1' || h[3] > '9'){
+                uint64_t left = avail - this->streamstart;
+                if (0 == this->streams || (left && left < 4 && !std::memcmp(h, "BZh", left < 3 ? left : 3))){
+                    /* no stream at all, or the file ends inside the header of the next one */
+                    std::cerr << "Inflate error: " << (left >= 4 ? "not a bzip2 stream" : "truncated input") << std::endl;
+                    throw "Inflate Error!";
+                }
+                /* end of the file, trailing garbage is ignored as bzip2 does */
+                this->parsed = true;
+                break;
+            }
+            this->level = h[3];
+            this->header = false;
+            this->streams++;
+            this->hcrc = 0;
+            this->blockstart = ZBZ2_NONE;
+            this->scan = this->streamstart + 4;
+            this->lowbit = this->scan * 8;
+            this->window = 0;
+            continue;
+        }
+        if (this->scan == avail){
+            if (this->io->eof()){
+                /* truncated, the stream (and the block being split) has no end */
+                std::cerr << "Inflate error: truncated input" << std::endl;
+                throw "Inflate Error!";
+            }
+            this->readRaw();
+            continue;
+        }
+        const std::array<uint8_t, 256> &filter = magicFilter();
+        bool wait = false;
+        while (this->scan < avail && this->blocks.size() == queued && !wait){
+            uint64_t prev = this->window;
+            this->window = (this->window << 8) | this->raw[this->scan - this->rawbase];
+            this->scan++;
+            uint8_t shifts = filter[(this->window >> 8) & 0xff];
+            for (int k = 7; shifts && k >= 0; k--){
+                if (!(shifts & (1 << k))){
+                    continue;
+                }
+                uint64_t magic = (this->window >> k) & ZBZ2_MAGIC_MASK;
+                if (ZBZ2_BLOCK_MAGIC != magic && ZBZ2_EOS_MAGIC != magic){
+                    continue;
+                }
+                uint64_t at = this->scan * 8 - k - 48;
+                if (this->scan * 8 < (uint64_t)k + 48 || at < this->lowbit){
+                    continue;
+                }
+                if (ZBZ2_BLOCK_MAGIC == magic){
+                    if (ZBZ2_NONE != this->blockstart){
+                        this->submitSplit(at);
+                    }
+                    this->blockstart = at;
+                    this->lowbit = at + 48;
+                    continue;
+                }
+                /* the crc and the next stream header are needed to tell an end of stream from data */
+                uint64_t next = (at + 80 + 7) / 8;
+                if (avail < next + 4 && !this->io->eof()){
+                    this->window = prev;
+                    this->scan--;
+                    wait = true;
+                    break;
+                }
+                if (avail < next){
+                    continue;
+                }
+                uint64_t base = this->rawbase * 8;
+                uint32_t stored = getBits(this->raw.data(), at + 48 - base, 32);
+                uint32_t crc = this->hcrc;
+                if (ZBZ2_NONE != this->blockstart && at - this->blockstart >= 80){
+                    crc = crcCombine(crc, getBits(this->raw.data(), this->blockstart + 48 - base, 32));
+                }
+                const uint8_t *h = this->raw.data() + (next - this->rawbase);
+                bool follows = avail == next ||
+                               (avail >= next + 4 && 'B' == h[0] && 'Z' == h[1] && 'h' == h[2] &&
+                                h[3] >= '1' && h[3] <= '9');
+                if (stored != crc && !follows){
+                    continue;
+                }
+                if (ZBZ2_NONE != this->blockstart){
+                    this->submitSplit(at);
+                }
+                block *b = new block;
+                b->eos = true;
+                b->ok = true;
+                b->crc = stored;
+                this->blocks.emplace_back(b);
+                PD("D eos crc:"<<stored<<" next:"<<next<<std::endl);
+                this->header = true;
+                this->streamstart = next;
+                break;
+            }
+        }
+        if (wait){
+            this->readRaw();
+        }
+    }
+    return this->blocks.size() > queued;
+}
+
+/* queue the block being split, it ends at bit end */
+void ZFileBZ2::submitSplit(uint64_t end){
+    block *b = new block;
+    uint64_t first = this->blockstart / 8;
+    uint64_t last = (end + 7) / 8;
+    b->in.assign(this->raw.begin() + (first - this->rawbase), this->raw.begin() + (last - this->rawbase));
+    b->shift = this->blockstart % 8;
+    b->bits = end - this->blockstart;
+    b->level = this->level;
+    /* a piece too short for a crc is never a block on its own */
+    b->crc = b->bits >= 80 ? getBits(b->in.data(), b->shift + 48, 32) : 0;
+    b->eos = false;
+    b->ok = false;
+    this->hcrc = crcCombine(this->hcrc, b->crc);
+    PD("D split start:"<<this->blockstart<<" bits:"<<b->bits<<" crc:"<<b->crc<<std::endl);
+    b->done = this->pool->submit([b]{ ZFileBZ2::inflateBlock(b); });
+    this->blocks.emplace_back(b);
+}
+
+/* append more compressed data, dropping what has already been split */
+void ZFileBZ2::readRaw(){
+    uint64_t keep = this->header ? this->streamstart :
+                    ZBZ2_NONE != this->blockstart ? this->blockstart / 8 : this->lowbit / 8;
+    if (keep - this->rawbase >= ZBUFSIZEBZ2){
+        this->raw.erase(this->raw.begin(), this->raw.begin() + (keep - this->rawbase));
+        this->rawbase = keep;
+    }
+    const uint8_t *next;
+    size_t size = this->input(this->inbuf, ZBUFSIZEBZ2, &next);
+    this->raw.insert(this->raw.end(), next, next + size);
+    PD("D 004 eof:"<<this->io->eof()<<" raw:"<<this->raw.size()<<std::endl);
+}
+
+size_t ZFileBZ2::peek(const char** s){
+    size_t out_size = 0;
+    if (this->mode == std::ios_base::in){
+        while (0 == (out_size = this->outsize - this->offsetbuf) && this->fill());
+    }
+    *s = (const char*)(this->outdata + this->offsetbuf);
+    return out_size;
+}
+
+void ZFileBZ2::consume(size_t n){
+    size_t out_size = this->outsize - this->offsetbuf;
+    n = n > out_size ? out_size : n;
+    this->offsetbuf += n;
+    this->pos += n;
+}
+
+uint64_t ZFileBZ2::tell() const{
+    return this->pos;
+}
@@ -27,6 +27,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <climits>
 
 #include <zutil/zfilegz.h>
 
@@ -44,14 +45,28 @@
 #define PD(_d) do {;}while(0)
 #endif
 
+/* deflate dictionary carried over between parallel chunks */
+#define ZGZIP_WINDOW (32 * 1024)
+
+ZFileGZ::ZFileGZ(const ZFileGZ::options &opt)
+    : inbuf(nullptr), outbuf(nullptr), opt(opt), pool(nullptr),
+      indexed(false), length(0), pos(0)
+{
+    this->inbuf = new uint8_t[ZBUFSIZEGZIP];
+    this->outbuf = new uint8_t[ZBUFSIZEGZIP];
+};
+
 ZFileGZ::ZFileGZ()
-    : inbuf(nullptr), outbuf(nullptr)
+    : inbuf(nullptr), outbuf(nullptr), pool(nullptr),
+      indexed(false), length(0), pos(0)
 {
     this->inbuf = new uint8_t[ZBUFSIZEGZIP];
     this->outbuf = new uint8_t[ZBUFSIZEGZIP];
 };
 
 ZFileGZ::~ZFileGZ(){
+    /* join the workers before the blocks they use go away */
+    if (this->pool)   delete this->pool;
     if (this->inbuf)  delete[] this->inbuf;
     if (this->outbuf) delete[] this->outbuf;
 };
@@ -62,6 +77,9 @@ void ZFileGZ::open(const char* filename, std::ios_base::openmode mode){
         /* allocate inflate state */
         this->offsetbuf = 0;
         this->status = Z_OK;
+        this->pos = 0;
+        this->index.clear();
+        this->indexed = false;
         this->strm.zalloc = nullptr;
         this->strm.zfree = nullptr;
         this->strm.opaque = nullptr;
@@ -74,6 +92,27 @@ void ZFileGZ::open(const char* filename, std::ios_base::openmode mode){
             throw "Decoder Not initialized!";
         }
     }
+    if (this->mode == std::ios_base::out && this->opt.threads > 1){
+        /*
+         * pigz style: the chunks are raw deflate streams, each primed
+         * with the last 32k of the previous chunk and terminated by a
+         * sync flush (the last one by Z_FINISH), so they can be joined
+         * in a single gzip member between our own header and trailer.
+         */
+        const uint8_t header[10] = {
+            0x1f, 0x8b, Z_DEFLATED, 0,  /* magic, method, flags */
+            0, 0, 0, 0,                 /* mtime */
+            (uint8_t)(this->opt.level >= Z_BEST_COMPRESSION ? 2 :
+                      this->opt.level == Z_BEST_SPEED ? 4 : 0), /* xfl */
+            3 };                        /* os: unix */
+        this->io->write((const char*)header, sizeof(header));
+        this->pool = new ZThreadPool(this->opt.threads);
+        this->current.reset(new block);
+        this->window.clear();
+        this->crc = crc32(0L, Z_NULL, 0);
+        this->isize = 0;
+        return;
+    }
     if (this->mode == std::ios_base::out){
         this->strm.zalloc = nullptr;
         this->strm.zfree = nullptr;
@@ -82,25 +121,40 @@ void ZFileGZ::open(const char* filename, std::ios_base::openmode mode){
         this->strm.avail_in = 0;
         this->strm.next_out = this->outbuf;
         this->strm.avail_out = ZBUFSIZEGZIP;
-        const int windowsBits = 15;
         const int GZIP_ENCODING = 16;
 
         //deflateInit(&this->strm, 9);
 
-        deflateInit2 (&this->strm, Z_BEST_COMPRESSION, Z_DEFLATED,
-                      windowsBits | GZIP_ENCODING,
-                      8,
-                      Z_DEFAULT_STRATEGY);
+        if (Z_OK != deflateInit2 (&this->strm, this->opt.level, Z_DEFLATED,
+                      this->opt.window_bits | GZIP_ENCODING,
+                      this->opt.mem_level,
+                      this->opt.strategy)){
+            std::cerr << "Error initializing the encoder!\n";
+            throw "Encoder Not initialized!";
+        }
     }
 }
 
 void ZFileGZ::close(){
-    if (this->mode == std::ios_base::out){
+    if (this->mode == std::ios_base::out && this->pool){
+        this->submitBlock(true);
+        this->drainBlocks(true);
+        uint8_t trailer[8];
+        for (int i = 0; i < 4; i++){
+            trailer[i]     = (this->crc   >> (8 * i)) & 0xff;
+            trailer[i + 4] = (this->isize >> (8 * i)) & 0xff;
+        }
+        this->io->write((const char*)trailer, sizeof(trailer));
+        delete this->pool;
+        this->pool = nullptr;
+        this->current.reset();
+        PD("D [close](out) parallel crc:"<<this->crc<<" isize:"<<this->isize<<std::endl);
+    }else if (this->mode == std::ios_base::out){
         int ret = deflate(&this->strm,Z_FINISH);
         // PD("D [close](out) deflate_end:"<< ret << "avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
         if (this->strm.avail_out != ZBUFSIZEGZIP) {
             size_t write_size = ZBUFSIZEGZIP - this->strm.avail_out;
-            this->fs.write((char*)(this->outbuf), write_size);
+            this->io->write((char*)(this->outbuf), write_size);
         }
         ret = deflateEnd(&this->strm);
         PD("D [close](out) deflate_end:"<< ret << "avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
@@ -116,26 +170,23 @@ size_t ZFileGZ::write (const char* s, size_t n){
         // Error, Not possible to read here
         return 0;
     }
+    if (this->pool){
+        return this->writeParallel(s, n);
+    }
     size_t s_offset = 0;
 
-    while (true) {
-        //PD("D 001 ZBUFSIZEGZIP:"<<ZBUFSIZEGZIP<<" n:"<<n<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
-        if (this->strm.avail_in == 0 && 0 != n) {
-            size_t copy_size = ZBUFSIZEGZIP > n ? n : ZBUFSIZEGZIP;
-            std::memcpy(this->inbuf, s + s_offset, copy_size);
-            this->strm.avail_in = copy_size;
-            s_offset += copy_size;
-            n -= copy_size;
-        }
-
-        this->strm.next_in = this->inbuf;
-        this->strm.next_out = this->outbuf;
+    /* deflate reads straight from the caller's buffer */
+    this->strm.next_out = this->outbuf;
+    while (0 != n) {
+        uInt chunk_size = n > UINT_MAX ? UINT_MAX : n;
+        this->strm.next_in = (Bytef*)(s + s_offset);
+        this->strm.avail_in = chunk_size;
 
-        PD("D 002 eof:"<<this->fs.eof()<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+        PD("D 002 eof:"<<this->io->eof()<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
 
         while (this->strm.avail_in){
             int ret = deflate(&strm, Z_NO_FLUSH);
-            PD("<--- D 010 eof:"<<this->fs.eof()<<" gzip_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+            PD("<--- D 010 eof:"<<this->io->eof()<<" gzip_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
 
             if (ret != Z_OK) {
                 return 0;
@@ -143,17 +194,193 @@ size_t ZFileGZ::write (const char* s, size_t n){
 
             if (this->strm.avail_out != ZBUFSIZEGZIP) {
                 size_t write_size = ZBUFSIZEGZIP - this->strm.avail_out;
-                this->fs.write((char*)(this->outbuf), write_size);
+                this->io->write((char*)(this->outbuf), write_size);
                 this->strm.avail_out = ZBUFSIZEGZIP;
                 this->strm.next_out = this->outbuf;
             }
         }
+        s_offset += chunk_size;
+        n -= chunk_size;
+    }
+    return s_offset;
+}
 
-        if (0 == n){
-            return s_offset;
+size_t ZFileGZ::writeParallel (const char* s, size_t n){
+    size_t s_offset = 0;
+    while (0 != n) {
+        std::vector<uint8_t> &in = this->current->in;
+        size_t copy_size = this->opt.block_size - in.size();
+        copy_size = copy_size > n ? n : copy_size;
+        in.insert(in.end(), (const uint8_t*)s + s_offset, (const uint8_t*)s + s_offset + copy_size);
+        s_offset += copy_size;
+        n -= copy_size;
+        if (in.size() == this->opt.block_size){
+            this->submitBlock(false);
+            this->drainBlocks(false);
+        }
+    }
+    return s_offset;
+}
+
+void ZFileGZ::submitBlock(bool last){
+    block *b = this->current.release();
+    b->dict = this->window;
+    b->last = last;
+
+    /* the next chunk is primed with the last 32k seen so far */
+    if (b->in.size() >= ZGZIP_WINDOW){
+        this->window.assign(b->in.end() - ZGZIP_WINDOW, b->in.end());
+    }else{
+        this->window.insert(this->window.end(), b->in.begin(), b->in.end());
+        if (this->window.size() > ZGZIP_WINDOW){
+            this->window.erase(this->window.begin(), this->window.end() - ZGZIP_WINDOW);
         }
     }
+
+    const ZFileGZ::options &opt = this->opt;
+    b->done = this->pool->submit([b, opt]{ ZFileGZ::deflateBlock(b, opt); });
+    this->blocks.emplace_back(b);
+    if (!last){
+        this->current.reset(new block);
+    }
 }
+
+/*
+ * Write the finished chunks in order; unless all is requested only the
+ * ones already done are written, waiting just when too many are queued.
+ */
+void ZFileGZ::drainBlocks(bool all){
+    while (!this->blocks.empty()){
+        block *b = this->blocks.front().get();
+        if (!all && this->blocks.size() <= 2 * this->opt.threads &&
+            std::future_status::ready != b->done.wait_for(std::chrono::seconds(0))){
+            return;
+        }
+        b->done.get(); /* rethrow the worker errors */
+        this->io->write((const char*)b->out.data(), b->out.size());
+        this->crc = crc32_combine(this->crc, b->crc, b->in.size());
+        this->isize += b->in.size();
+        PD("D drain in:"<<b->in.size()<<" out:"<<b->out.size()<<std::endl);
+        this->blocks.pop_front();
+    }
+}
+
+void ZFileGZ::deflateBlock(block *b, const ZFileGZ::options &opt){
+    z_stream zs = {nullptr};
+    if (Z_OK != deflateInit2(&zs, opt.level, Z_DEFLATED, -opt.window_bits, opt.mem_level, opt.strategy)){
+        throw "Encoder Not initialized!";
+    }
+    if (!b->dict.empty()){
+        deflateSetDictionary(&zs, b->dict.data(), b->dict.size());
+    }
+    int flush = b->last ? Z_FINISH : Z_SYNC_FLUSH;
+    size_t have = 0;
+    b->out.resize(deflateBound(&zs, b->in.size()) + 16);
+    zs.next_in = b->in.data();
+    zs.avail_in = b->in.size();
+    while (true) {
+        zs.next_out = b->out.data() + have;
+        zs.avail_out = b->out.size() - have;
+        int ret = deflate(&zs, flush);
+        have = b->out.size() - zs.avail_out;
+        if (Z_STREAM_ERROR == ret){
+            deflateEnd(&zs);
+            throw "Deflate Error!";
+        }
+        if (b->last ? Z_STREAM_END == ret : 0 != zs.avail_out){
+            break;
+        }
+        b->out.resize(b->out.size() * 2);
+    }
+    deflateEnd(&zs);
+    b->out.resize(have);
+    b->crc = crc32(0L, b->in.data(), b->in.size());
+}
+
+std::vector<char> ZFileGZ::compress(const char* s, size_t n, const ZFileGZ::options &opt){
+    z_stream zs = {nullptr};
+    const int GZIP_ENCODING = 16;
+    if (Z_OK != deflateInit2(&zs, opt.level, Z_DEFLATED, opt.window_bits | GZIP_ENCODING,
+                             opt.mem_level, opt.strategy)){
+        std::cerr << "Error initializing the encoder!\n";
+        throw "Encoder Not initialized!";
+    }
+    /* gzip header and trailer included */
+    std::vector<char> out(deflateBound(&zs, n));
+    size_t in_left = n;
+    size_t have = 0;
+    int ret;
+    zs.next_in = (Bytef*)s;
+    do {
+        /* a single call unless the sizes do not fit in uInt */
+        uInt in_size = in_left > UINT_MAX ? UINT_MAX : in_left;
+        uInt out_size = out.size() - have > UINT_MAX ? UINT_MAX : out.size() - have;
+        zs.avail_in = in_size;
+        zs.next_out = (Bytef*)out.data() + have;
+        zs.avail_out = out_size;
+        ret = deflate(&zs, in_size == in_left ? Z_FINISH : Z_NO_FLUSH);
+        in_left -= in_size - zs.avail_in;
+        have += out_size - zs.avail_out;
+    } while (Z_OK == ret);
+    deflateEnd(&zs);
+    if (Z_STREAM_END != ret){
+        std::cerr << "Deflate error: " << ret << "\n";
+        throw "Deflate Error!";
+    }
+    out.resize(have);
+    PD("D [compress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+std::vector<char> ZFileGZ::decompress(const char* s, size_t n){
+    z_stream zs = {nullptr};
+    if (Z_OK != inflateInit2(&zs, (15 + 32))){
+        std::cerr << "Error initializing the decoder!\n";
+        throw "Decoder Not initialized!";
+    }
+    const uint8_t *in = (const uint8_t*)s;
+    size_t size = 0;
+    if (n >= 18 /* empty member */){
+        size = (size_t)in[n - 4] | (size_t)in[n - 3] << 8 | (size_t)in[n - 2] << 16 | (size_t)in[n - 1] << 24;
+    }
+    /* deflate does not go beyond 1032:1, do not trust a bogus trailer */
+    std::vector<char> out(size / 1032 > n ? n : size);
+    size_t in_left = n;
+    size_t have = 0;
+    int ret;
+    zs.next_in = (Bytef*)in;
+    while (true) {
+        if (have == out.size()){
+            out.resize(out.size() < ZBUFSIZEGZIP ? ZBUFSIZEGZIP : out.size() * 2);
+        }
+        uInt in_size = in_left > UINT_MAX ? UINT_MAX : in_left;
+        uInt out_size = out.size() - have > UINT_MAX ? UINT_MAX : out.size() - have;
+        zs.avail_in = in_size;
+        zs.next_out = (Bytef*)out.data() + have;
+        zs.avail_out = out_size;
+        ret = inflate(&zs, Z_NO_FLUSH);
+        in_left -= in_size - zs.avail_in;
+        have += out_size - zs.avail_out;
+        if (Z_STREAM_END == ret){
+            /* gzip members one after the other, anything else is trailing garbage */
+            if (in_left >= 2 && 0x1f == zs.next_in[0] && 0x8b == zs.next_in[1]){
+                inflateReset(&zs);
+                continue;
+            }
+            break;
+        }
+        if ((Z_OK != ret && Z_BUF_ERROR != ret) || (0 == in_left && have < out.size())){
+            std::cerr << "Inflate error: " << (zs.msg ? zs.msg : "truncated stream") << "\n";
+            inflateEnd(&zs);
+            throw "Inflate Error!";
+        }
+    }
+    inflateEnd(&zs);
+    out.resize(have);
+    PD("D [decompress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
 /*
  * Decompress Routine taken from:
  *   https://www.zlib.net/zlib_how.html
@@ -183,54 +410,308 @@ size_t ZFileGZ::read (char* s, size_t n){
         s_offset += copy_size;
         n -= copy_size;
 
-        PD("D 001 eof:"<<this->fs.eof()<<" n:"<<n<<" out_size:"<<out_size
+        PD("D 001 eof:"<<this->io->eof()<<" n:"<<n<<" out_size:"<<out_size
            <<" copy_size:"<<copy_size<<" s_offset:"<<s_offset<<std::endl);
 
-        if (0 == n || Z_STREAM_END == this->status ){
+        if (0 == n){
+            this->pos += s_offset;
+            return s_offset;
+        }
+        if (n >= ZBUFSIZEGZIP){
+            /* the outbuf is empty, large reads are decoded straight into s */
+            size_t direct_size = n > UINT_MAX ? UINT_MAX : n;
+            bool more = this->fill((uint8_t*)s + s_offset, direct_size);
+            direct_size -= this->strm.avail_out;
+            this->strm.next_out = this->outbuf;
+            this->strm.avail_out = ZBUFSIZEGZIP;
+            s_offset += direct_size;
+            n -= direct_size;
+            if (!more){
+                this->pos += s_offset;
+                return s_offset;
+            }
+        }else if (!this->fill()){
+            this->pos += s_offset;
             return s_offset;
         }
+    }
+    return 0;
+}
 
-        /* the outbuf is empty and we need to fetch more data */
-        this->offsetbuf = 0;
-        this->strm.next_out = this->outbuf;
-        this->strm.avail_out = ZBUFSIZEGZIP;
+/* the outbuf is empty, decode the next chunk; false when nothing else can be decoded */
+bool ZFileGZ::fill(){
+    return this->fill(this->outbuf, ZBUFSIZEGZIP);
+}
 
-        PD("D 003 eof:"<<this->fs.eof()<<std::endl);
+/* decode into out, either the outbuf or the caller's buffer */
+bool ZFileGZ::fill(uint8_t *out, size_t size){
+    this->offsetbuf = 0;
+    this->strm.next_out = out;
+    this->strm.avail_out = size;
+    if (Z_STREAM_END == this->status){
+        return false;
+    }
 
-        if (this->strm.avail_in == 0 && !this->fs.eof()) {
-            this->strm.next_in = this->inbuf;
-             // read data as a block:
-             this->fs.read((char*)(this->inbuf), ZBUFSIZEGZIP);
+    PD("D 003 eof:"<<this->io->eof()<<std::endl);
 
-             if (this->fs){
-                 this->strm.avail_in = ZBUFSIZEGZIP;
-             }else{
-                 this->strm.avail_in = this->fs.gcount();
-             }
-             PD("D 004 eof:"<<this->fs.eof()<<" avail_in:"<<this->strm.avail_in<<std::endl);
+    if (this->strm.avail_in == 0 && !this->io->eof()) {
+        const uint8_t *next;
+         // read data as a block:
+         this->strm.avail_in = this->input(this->inbuf, ZBUFSIZEGZIP, &next);
+         this->strm.next_in = (Bytef*)next;
+         PD("D 004 eof:"<<this->io->eof()<<" avail_in:"<<this->strm.avail_in<<std::endl);
+    }
+
+    PD("D 009 eof:"<<this->io->eof()<<" gzip_ret:"<<9<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+    int ret = inflate(&strm, Z_NO_FLUSH);
+    PD("D 010 eof:"<<this->io->eof()<<" gzip_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+
+    switch (ret) {
+        case Z_NEED_DICT:
+            PD("D 015 Z_NEED_DICT!!!"<<std::endl);
+            return false;
+        case Z_DATA_ERROR:
+            PD("D 015 Z_DATA_ERROR!!!"<<std::endl);
+            return false;
+        case Z_MEM_ERROR:
+            // (void)inflateEnd(&this->strm);
+            PD("D 015 Z_MEM_ERROR!!!"<<std::endl);
+            return false;
+        case Z_BUF_ERROR:
+            /* truncated stream, nothing else can be decoded */
+            return !(0 == this->strm.avail_in && this->io->eof());
+        case Z_STREAM_END:
+            if (this->strm.avail_out > 0){
+                this->status = Z_STREAM_END;
+            }
+            return true;
+    }
+    return true;
+}
+
+size_t ZFileGZ::peek(const char** s){
+    size_t out_size = 0;
+    if (this->mode == std::ios_base::in){
+        while (0 == (out_size = ZBUFSIZEGZIP - this->strm.avail_out - this->offsetbuf) && this->fill());
+    }
+    *s = (const char*)(this->outbuf + this->offsetbuf);
+    return out_size;
+}
+
+void ZFileGZ::consume(size_t n){
+    size_t out_size = ZBUFSIZEGZIP - this->strm.avail_out - this->offsetbuf;
+    n = n > out_size ? out_size : n;
+    this->offsetbuf += n;
+    this->pos += n;
+}
+
+uint64_t ZFileGZ::tell() const{
+    return this->pos;
+}
+
+/*
+ * Index build and access point restore taken from zran.c:
+ *   https://github.com/madler/zlib/blob/master/examples/zran.c
+ */
+void ZFileGZ::buildIndex(){
+    std::ifstream in(this->filename, std::ifstream::binary);
+    z_stream zs = {nullptr};
+    if (!in || Z_OK != inflateInit2(&zs, (15 + 32))){
+        std::cerr << "Error initializing the index decoder!\n";
+        throw "Index Not built!";
+    }
+    std::vector<uint8_t> input(ZBUFSIZEGZIP);
+    std::vector<uint8_t> window(ZGZIP_WINDOW);
+    uint64_t totin = 0, totout = 0, last = 0;
+    int ret = Z_OK;
+
+    this->index.clear();
+    zs.avail_out = 0;
+    do {
+        in.read((char*)input.data(), input.size());
+        zs.avail_in = in.gcount();
+        zs.next_in = input.data();
+        if (0 == zs.avail_in){
+            /* truncated stream, index what we have */
+            break;
         }
+        do {
+            /* the output is only kept as a circular 32k window */
+            if (0 == zs.avail_out){
+                zs.avail_out = ZGZIP_WINDOW;
+                zs.next_out = window.data();
+            }
+            totin += zs.avail_in;
+            totout += zs.avail_out;
+            ret = inflate(&zs, Z_BLOCK);
+            totin -= zs.avail_in;
+            totout -= zs.avail_out;
+            if (Z_NEED_DICT == ret || Z_DATA_ERROR == ret || Z_MEM_ERROR == ret){
+                (void)inflateEnd(&zs);
+                std::cerr << "Error reading the stream while indexing!\n";
+                throw "Index Not built!";
+            }
+            if (Z_STREAM_END == ret){
+                break;
+            }
+            /* at the end of a deflate block, but not of the last one */
+            if ((zs.data_type & 128) && !(zs.data_type & 64) &&
+                totout - last >= this->opt.index_span){
+                point p;
+                p.out = totout;
+                p.in = totin;
+                p.bits = zs.data_type & 7;
+                p.window.resize(ZGZIP_WINDOW);
+                size_t left = zs.avail_out;
+                std::memcpy(p.window.data(), window.data() + ZGZIP_WINDOW - left, left);
+                std::memcpy(p.window.data() + left, window.data(), ZGZIP_WINDOW - left);
+                this->index.push_back(std::move(p));
+                last = totout;
+                PD("D [index] out:"<<totout<<" in:"<<totin<<" bits:"<<(zs.data_type & 7)<<std::endl);
+            }
+        } while (zs.avail_in);
+    } while (Z_STREAM_END != ret);
 
-        PD("D 009 eof:"<<this->fs.eof()<<" gzip_ret:"<<9<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
-        int ret = inflate(&strm, Z_NO_FLUSH);
-        PD("D 010 eof:"<<this->fs.eof()<<" gzip_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+    (void)inflateEnd(&zs);
+    this->length = totout;
+    this->indexed = true;
+}
 
-        switch (ret) {
-            case Z_NEED_DICT:
-                PD("D 015 Z_NEED_DICT!!!"<<std::endl);
-                return 0;
-            case Z_DATA_ERROR:
-                PD("D 015 Z_DATA_ERROR!!!"<<std::endl);
-                return 0;
-            case Z_MEM_ERROR:
-                // (void)inflateEnd(&this->strm);
-                PD("D 015 Z_MEM_ERROR!!!"<<std::endl);
-                return 0;
-            case Z_STREAM_END:
-                if (this->strm.avail_out > 0){
-                    this->status = Z_STREAM_END;
-                }
-                continue;
+/* resume the decoder at the access point, or at the beginning if null */
+void ZFileGZ::restart(const point *p){
+    if (nullptr == p){
+        this->io->seek(0);
+        (void)inflateReset2(&this->strm, (15 + 32));
+        this->pos = 0;
+    }else{
+        this->io->seek(p->in - (p->bits ? 1 : 0));
+        (void)inflateReset2(&this->strm, -15);
+        if (p->bits){
+            uint8_t c = 0;
+            (void)this->io->read((char*)&c, 1);
+            (void)inflatePrime(&this->strm, p->bits, c >> (8 - p->bits));
         }
+        (void)inflateSetDictionary(&this->strm, p->window.data(), ZGZIP_WINDOW);
+        this->pos = p->out;
     }
-    return 0;
+    this->strm.next_in = this->inbuf;
+    this->strm.avail_in = 0;
+    this->strm.next_out = this->outbuf;
+    this->strm.avail_out = ZBUFSIZEGZIP;
+    this->offsetbuf = 0;
+    this->status = Z_OK;
+}
+
+bool ZFileGZ::seek(uint64_t offset){
+    if (this->mode != std::ios_base::in){
+        return false;
+    }
+    if (!this->indexed){
+        this->buildIndex();
+    }
+    if (offset > this->length){
+        return false;
+    }
+
+    /* closest access point before the offset */
+    const point *p = nullptr;
+    for (const point &i : this->index){
+        if (i.out > offset) break;
+        p = &i;
+    }
+    /* going on from here is cheaper than any restart */
+    uint64_t from = p ? p->out : 0;
+    if (offset < this->pos || this->pos < from){
+        this->restart(p);
+    }
+
+    PD("D [seek] offset:"<<offset<<" from:"<<this->pos<<std::endl);
+    while (this->pos < offset){
+        const char *p;
+        size_t n = this->peek(&p);
+        if (0 == n){
+            return false;
+        }
+        this->consume(offset - this->pos > n ? n : offset - this->pos);
+    }
+    return true;
+}
+
+/*
+ * Sidecar index: magic, compressed size (to spot a stale index),
+ * uncompressed length, count and the access points.
+ */
+static const char ZGZIP_INDEX_MAGIC[8] = {'Z','G','Z','I','D','X','0','1'};
+
+void ZFileGZ::saveIndex(const char* filename){
+    if (!this->indexed){
+        this->buildIndex();
+    }
+    std::ifstream in(this->filename, std::ifstream::binary | std::ifstream::ate);
+    uint64_t size = in.tellg();
+    uint64_t count = this->index.size();
+    std::ofstream idx(filename, std::ofstream::binary);
+    idx.write(ZGZIP_INDEX_MAGIC, sizeof(ZGZIP_INDEX_MAGIC));
+    idx.write((const char*)&size, sizeof(size));
+    idx.write((const char*)&this->length, sizeof(this->length));
+    idx.write((const char*)&count, sizeof(count));
+    for (const point &p : this->index){
+        uint64_t bits = p.bits;
+        idx.write((const char*)&p.out, sizeof(p.out));
+        idx.write((const char*)&p.in, sizeof(p.in));
+        idx.write((const char*)&bits, sizeof(bits));
+        idx.write((const char*)p.window.data(), ZGZIP_WINDOW);
+    }
+    if (!idx){
+        std::cerr << "Error writing the index " << filename << "\n";
+        throw "Index Not saved!";
+    }
+}
+
+bool ZFileGZ::loadIndex(const char* filename){
+    std::ifstream idx(filename, std::ifstream::binary | std::ifstream::ate);
+    std::ifstream in(this->filename, std::ifstream::binary | std::ifstream::ate);
+    uint64_t idxsize = idx ? (uint64_t)idx.tellg() : 0;
+    idx.seekg(0);
+    char magic[sizeof(ZGZIP_INDEX_MAGIC)];
+    uint64_t size = 0, length = 0, count = 0;
+    idx.read(magic, sizeof(magic));
+    idx.read((char*)&size, sizeof(size));
+    idx.read((char*)&length, sizeof(length));
+    idx.read((char*)&count, sizeof(count));
+    if (!idx || std::memcmp(magic, ZGZIP_INDEX_MAGIC, sizeof(magic)) ||
+        size != (uint64_t)in.tellg()){
+        PD("D [loadIndex] missing or stale index:"<<filename<<std::endl);
+        return false;
+    }
+    /* out, in, bits and the window, as saveIndex() writes them */
+    const uint64_t record = 3 * sizeof(uint64_t) + ZGZIP_WINDOW;
+    if (count > (idxsize - (uint64_t)idx.tellg()) / record){
+        PD("D [loadIndex] corrupted index:"<<filename<<" count:"<<count<<std::endl);
+        return false;
+    }
+    std::vector<point> index(count);
+    const point *prev = nullptr;
+    for (point &p : index){
+        uint64_t bits = 0;
+        idx.read((char*)&p.out, sizeof(p.out));
+        idx.read((char*)&p.in, sizeof(p.in));
+        idx.read((char*)&bits, sizeof(bits));
+        if (!idx || bits > 7 || p.out > length || p.in > size ||
+            (prev && (p.out < prev->out || p.in < prev->in))){
+            PD("D [loadIndex] corrupted index:"<<filename<<std::endl);
+            return false;
+        }
+        p.bits = bits;
+        p.window.resize(ZGZIP_WINDOW);
+        idx.read((char*)p.window.data(), ZGZIP_WINDOW);
+        prev = &p;
+    }
+    if (!idx){
+        return false;
+    }
+    this->index = std::move(index);
+    this->length = length;
+    this->indexed = true;
+    return true;
 }
@@ -0,0 +1,360 @@
+/* zfilelz4.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <iostream>
+#include <cstring>
+
+#include <zutil/zfilelz4.h>
+
+#ifdef TEST_BUFFER
+#define ZBUFSIZELZ4 ( TEST_BUFFER )
+#else
+#define ZBUFSIZELZ4 (0x1000 * 0x80) /* 512k */
+#endif
+
+// #define DEBUG
+
+#ifdef DEBUG
+#define PD(_d) do { std::cout << " #(lz4) " << _d ;}while(0)
+#else
+#define PD(_d) do {;}while(0)
+#endif
+
+ZFileLZ4::ZFileLZ4(const ZFileLZ4::options &opt)
+    : cctx(nullptr), dctx(nullptr), next_in(nullptr), avail_in(0),
+      inbuf(nullptr), outbuf(nullptr), outbufsize(ZBUFSIZELZ4), outsize(0),
+      offsetbuf(0), end(false), hint(0), opt(opt), pos(0)
+{
+    this->inbuf = new uint8_t[ZBUFSIZELZ4];
+    this->outbuf = new uint8_t[ZBUFSIZELZ4];
+}
+
+ZFileLZ4::ZFileLZ4()
+    : cctx(nullptr), dctx(nullptr), next_in(nullptr), avail_in(0),
+      inbuf(nullptr), outbuf(nullptr), outbufsize(ZBUFSIZELZ4), outsize(0),
+      offsetbuf(0), end(false), hint(0), pos(0)
+{
+    this->inbuf = new uint8_t[ZBUFSIZELZ4];
+    this->outbuf = new uint8_t[ZBUFSIZELZ4];
+}
+
+ZFileLZ4::~ZFileLZ4(){
+    LZ4F_freeCompressionContext(this->cctx);
+    LZ4F_freeDecompressionContext(this->dctx);
+    if (this->inbuf)  delete[] this->inbuf;
+    if (this->outbuf) delete[] this->outbuf;
+}
+
+void ZFileLZ4::preferences(const ZFileLZ4::options &opt, LZ4F_preferences_t *prefs){
+    std::memset(prefs, 0, sizeof(*prefs));
+    prefs->frameInfo.blockSizeID = (LZ4F_blockSizeID_t)opt.block_size;
+    prefs->frameInfo.blockMode = opt.block_independent ? LZ4F_blockIndependent : LZ4F_blockLinked;
+    prefs->frameInfo.contentChecksumFlag = opt.checksum ? LZ4F_contentChecksumEnabled : LZ4F_noContentChecksum;
+    prefs->frameInfo.blockChecksumFlag = opt.block_checksum ? LZ4F_blockChecksumEnabled : LZ4F_noBlockChecksum;
+    prefs->compressionLevel = opt.level;
+}
+
+std::vector<char> ZFileLZ4::compress(const char* s, size_t n, const ZFileLZ4::options &opt){
+    LZ4F_preferences_t prefs;
+    ZFileLZ4::preferences(opt, &prefs);
+    /* recorded in the frame header, decompress() reads it back */
+    prefs.frameInfo.contentSize = n;
+    std::vector<char> out(LZ4F_compressFrameBound(n, &prefs));
+    size_t ret = LZ4F_compressFrame(out.data(), out.size(), s, n, &prefs);
+    if (LZ4F_isError(ret)){
+        std::cerr << "Deflate error: " << LZ4F_getErrorName(ret) << std::endl;
+        throw "Deflate Error!";
+    }
+    out.resize(ret);
+    PD("D [compress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+std::vector<char> ZFileLZ4::decompress(const char* s, size_t n){
+    LZ4F_dctx *dctx = nullptr;
+    size_t ret = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+    if (LZ4F_isError(ret)){
+        std::cerr << "Error initializing the decoder: " << LZ4F_getErrorName(ret) << std::endl;
+        throw "Decoder Not initialized!";
+    }
+    std::vector<char> out;
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    /* the header of the first frame, the rest is still to decode */
+    LZ4F_frameInfo_t info;
+    size_t header = n;
+    ret = LZ4F_getFrameInfo(dctx, &info, s, &header);
+    if (!LZ4F_isError(ret)){
+        in_pos = header;
+        /* frames written without the content size grow the output, and so does a
+         * size beyond the 255:1 lz4 can reach, the header can claim anything */
+        uint64_t size = info.contentSize ? info.contentSize : 2 * n;
+        out.resize(size / 255 > n ? n * 255 : size);
+        while (ret && in_pos < n){
+            if (out_pos == out.size()){
+                out.resize(out.size() < ZBUFSIZELZ4 ? ZBUFSIZELZ4 : out.size() * 2);
+            }
+            size_t in_size = n - in_pos;
+            size_t out_size = out.size() - out_pos;
+            ret = LZ4F_decompress(dctx, out.data() + out_pos, &out_size, s + in_pos, &in_size, nullptr);
+            if (LZ4F_isError(ret)){
+                break;
+            }
+            in_pos += in_size;
+            out_pos += out_size;
+            if (0 == ret && in_pos < n){
+                /* a concatenated frame, the context is ready for it */
+                ret = 1;
+            }
+            if (0 == in_size && 0 == out_size && out_pos < out.size()){
+                break;
+            }
+        }
+    }
+    LZ4F_freeDecompressionContext(dctx);
+    if (LZ4F_isError(ret)){
+        std::cerr << "Inflate error: " << LZ4F_getErrorName(ret) << std::endl;
+        throw "Inflate Error!";
+    }
+    if (ret){
+        std::cerr << "Inflate error: truncated input" << std::endl;
+        throw "Inflate Error!";
+    }
+    out.resize(out_pos);
+    PD("D [decompress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+void ZFileLZ4::open(const char* filename, std::ios_base::openmode mode){
+    ZFile::open(filename, mode);
+    if (this->mode == std::ios_base::in){
+        size_t ret = 0;
+        if (nullptr == this->dctx){
+            ret = LZ4F_createDecompressionContext(&this->dctx, LZ4F_VERSION);
+        }else{
+            LZ4F_resetDecompressionContext(this->dctx);
+        }
+        if (LZ4F_isError(ret)){
+            std::cerr << "Error initializing the decoder: " << LZ4F_getErrorName(ret) << std::endl;
+            throw "Decoder Not initialized!";
+        }
+        this->offsetbuf = 0;
+        this->outsize = 0;
+        this->end = false;
+        this->hint = 0;
+        this->pos = 0;
+        this->next_in = this->inbuf;
+        this->avail_in = 0;
+    }
+    if (this->mode == std::ios_base::out){
+        LZ4F_preferences_t prefs;
+        ZFileLZ4::preferences(this->opt, &prefs);
+        PD("D level:"<<this->opt.level<<" block_size:"<<this->opt.block_size
+           <<" independent:"<<this->opt.block_independent<<std::endl);
+
+        /* every LZ4F_compressUpdate() needs room for the worst case,
+         * the data buffered from the previous calls included */
+        size_t bound = LZ4F_compressBound(ZBUFSIZELZ4, &prefs);
+        if (bound > this->outbufsize){
+            delete[] this->outbuf;
+            this->outbuf = new uint8_t[bound];
+            this->outbufsize = bound;
+        }
+
+        size_t ret = 0;
+        if (nullptr == this->cctx){
+            ret = LZ4F_createCompressionContext(&this->cctx, LZ4F_VERSION);
+        }
+        if (!LZ4F_isError(ret)){
+            ret = LZ4F_compressBegin(this->cctx, this->outbuf, this->outbufsize, &prefs);
+        }
+        if (LZ4F_isError(ret)){
+            std::cerr << "Error initializing the encoder: " << LZ4F_getErrorName(ret) << std::endl;
+            throw "Encoder Not initialized!";
+        }
+        /* the frame header */
+        this->io->write((char*)(this->outbuf), ret);
+        this->offsetbuf = 0;
+    }
+}
+
+void ZFileLZ4::close(){
+    if (this->mode == std::ios_base::out){
+        size_t ret = LZ4F_compressEnd(this->cctx, this->outbuf, this->outbufsize, nullptr);
+        if (LZ4F_isError(ret)){
+            std::cerr << "Deflate error: " << LZ4F_getErrorName(ret) << std::endl;
+            throw "Deflate Error!";
+        }
+        if (ret){
+            this->io->write((char*)(this->outbuf), ret);
+        }
+        PD("D [close](out)"<<std::endl);
+    }else{
+        PD("D [close](in)"<<std::endl);
+    }
+    ZFile::close();
+}
+
+size_t ZFileLZ4::write (const char* s, size_t n){
+    if (this->mode != std::ios_base::out){
+        // Error, Not possible to read here
+        return 0;
+    }
+
+    /* LZ4F_compressUpdate reads straight from the caller's buffer,
+     * at most ZBUFSIZELZ4 at a time to fit the outbuf */
+    size_t s_offset = 0;
+    while (s_offset < n) {
+        size_t chunk = n - s_offset > ZBUFSIZELZ4 ? ZBUFSIZELZ4 : n - s_offset;
+        size_t ret = LZ4F_compressUpdate(this->cctx, this->outbuf, this->outbufsize,
+                                         s + s_offset, chunk, nullptr);
+        PD("D 010 ret:"<<ret<<" chunk:"<<chunk<<std::endl);
+        if (LZ4F_isError(ret)){
+            std::cerr << "Deflate error: " << LZ4F_getErrorName(ret) << std::endl;
+            throw "Deflate Error!";
+        }
+        if (ret){
+            this->io->write((char*)(this->outbuf), ret);
+        }
+        s_offset += chunk;
+    }
+    return n;
+}
+
+size_t ZFileLZ4::read (char* s, size_t n){
+    if (this->mode != std::ios_base::in){
+        // Error, Not possible to write here
+        return 0;
+    }
+
+    size_t s_offset = 0;
+
+    while (true) {
+        /*
+         *  this->outbuf    = [xxxxxxxxxx------]
+         *  this->outsize              ^
+         *  this->offsetbuf      ^
+         */
+        size_t out_size = this->outsize - this->offsetbuf;
+        size_t copy_size = out_size > n ? n : out_size;
+
+        std::memcpy(s + s_offset, this->outbuf + this->offsetbuf, copy_size);
+
+        this->offsetbuf += copy_size;
+        s_offset += copy_size;
+        n -= copy_size;
+
+        PD("D 001 eof:"<<this->io->eof()<<" out_size:"<<out_size
+           <<" copy_size:"<<copy_size<<" s_offset:"<<s_offset<<std::endl);
+
+        if (0 == n){
+            this->pos += s_offset;
+            return s_offset;
+        }
+        if (n >= ZBUFSIZELZ4){
+            /* the outbuf is empty, large reads are decoded straight into s */
+            bool more = this->fill((uint8_t*)s + s_offset, n);
+            size_t direct_size = this->outsize;
+            this->outsize = 0;
+            s_offset += direct_size;
+            n -= direct_size;
+            if (!more){
+                this->pos += s_offset;
+                return s_offset;
+            }
+        }else if (!this->fill()){
+            this->pos += s_offset;
+            return s_offset;
+        }
+    }
+}
+
+/* the outbuf is empty, decode the next chunk; false when nothing else can be decoded */
+bool ZFileLZ4::fill(){
+    return this->fill(this->outbuf, ZBUFSIZELZ4);
+}
+
+/* decode into out, either the outbuf or the caller's buffer */
+bool ZFileLZ4::fill(uint8_t *out, size_t size){
+    this->offsetbuf = 0;
+    this->outsize = 0;
+    if (this->end){
+        return false;
+    }
+
+    if (0 == this->avail_in && !this->io->eof()) {
+        // read data as a block:
+        this->avail_in = this->input(this->inbuf, ZBUFSIZELZ4, &this->next_in);
+        PD("D 004 eof:"<<this->io->eof()<<" avail_in:"<<this->avail_in<<std::endl);
+    }
+
+    /* frames follow each other, 0 is returned at the end of each one */
+    size_t out_size = size;
+    size_t in_size = this->avail_in;
+    size_t ret = LZ4F_decompress(this->dctx, out, &out_size, this->next_in, &in_size, nullptr);
+    PD("D 010 eof:"<<this->io->eof()<<" ret:"<<ret<<" in_size:"<<in_size<<" out_size:"<<out_size<<std::endl);
+    if (LZ4F_isError(ret)){
+        std::cerr << "Inflate error: " << LZ4F_getErrorName(ret) << std::endl;
+        throw "Inflate Error!";
+    }
+    this->next_in += in_size;
+    this->avail_in -= in_size;
+    this->outsize = out_size;
+    if (in_size || out_size){
+        this->hint = ret;
+    }
+    if (0 == out_size && 0 == this->avail_in && this->io->eof()){
+        /* end of the file, the last frame has to be complete */
+        if (this->hint){
+            std::cerr << "Inflate error: truncated input" << std::endl;
+            throw "Inflate Error!";
+        }
+        this->end = true;
+        return false;
+    }
+    return true;
+}
+
+size_t ZFileLZ4::peek(const char** s){
+    size_t out_size = 0;
+    if (this->mode == std::ios_base::in){
+        while (0 == (out_size = this->outsize - this->offsetbuf) && this->fill());
+    }
+    *s = (const char*)(this->outbuf + this->offsetbuf);
+    return out_size;
+}
+
+void ZFileLZ4::consume(size_t n){
+    size_t out_size = this->outsize - this->offsetbuf;
+    n = n > out_size ? out_size : n;
+    this->offsetbuf += n;
+    this->pos += n;
+}
+
+uint64_t ZFileLZ4::tell() const{
+    return this->pos;
+}
@@ -27,6 +27,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 #include <zutil/zfilelzo.h>
 
@@ -45,8 +46,17 @@
 #define PD(_d) do {;}while(0)
 #endif
 
+ZFileLZO::ZFileLZO(const ZFileLZO::options &opt)
+    : inbuf(nullptr), outbuf(nullptr), opt(opt),
+      descsize(0), chksize(0), indexed(false), length(0), pos(0), rablock(SIZE_MAX), raflags(0)
+{
+    this->inbuf = new uint8_t[ZBUFSIZELZO_IN];
+    this->outbuf = new uint8_t[ZBUFSIZELZO_OUT];
+};
+
 ZFileLZO::ZFileLZO()
-    : inbuf(nullptr), outbuf(nullptr)
+    : inbuf(nullptr), outbuf(nullptr),
+      descsize(0), chksize(0), indexed(false), length(0), pos(0), rablock(SIZE_MAX), raflags(0)
 {
     this->inbuf = new uint8_t[ZBUFSIZELZO_IN];
     this->outbuf = new uint8_t[ZBUFSIZELZO_OUT];
@@ -67,7 +77,15 @@ void ZFileLZO::open(const char* filename, std::ios_base::openmode mode){
         this->strm.avail_in = 0;
         this->strm.next_out = this->outbuf;
         this->strm.avail_out = ZBUFSIZELZO_OUT;
-        if(LZOP_OK != lzop_inflateInit(&this->strm)){
+        this->status = LZOP_OK;
+        this->pos = 0;
+        this->index.clear();
+        this->indexed = false;
+        this->rablock = SIZE_MAX;
+        lzop_options lopt = {};
+        lopt.threads = this->opt.threads;
+        lopt.verify = this->opt.verify;
+        if(LZOP_OK != lzop_inflateInit2(&this->strm, &lopt)){
             std::cerr << "Error initializing the decoder!\n";
             throw "Decoder Not initialized!";
         }
@@ -77,23 +95,39 @@ void ZFileLZO::open(const char* filename, std::ios_base::openmode mode){
         this->strm.avail_in = 0;
         this->strm.next_out = this->outbuf;
         this->strm.avail_out = ZBUFSIZELZO_OUT;
-        lzop_deflateInit(&this->strm, 9);
+        lzop_options lopt = {};
+        lopt.level = this->opt.level;
+        lopt.method = this->opt.method;
+        lopt.check = this->opt.chk;
+        lopt.block_size = this->opt.block_size;
+        lopt.threads = this->opt.threads;
+        if(LZOP_OK != lzop_deflateInit2(&this->strm, &lopt)){
+            std::cerr << "Error initializing the encoder!\n";
+            throw "Encoder Not initialized!";
+        }
     }
 }
 
 void ZFileLZO::close(){
     if (this->mode == std::ios_base::out){
-        int ret = lzop_deflate(&this->strm, LZOP_FLUSH);
-        // PD("D [close](out) deflate_end:"<< ret << "avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
-        if (this->strm.avail_out != ZBUFSIZELZO_OUT) {
-            size_t write_size = ZBUFSIZELZO_OUT - this->strm.avail_out;
-            this->fs.write((char*)(this->outbuf), write_size);
-        }
+        int ret;
+        /* the pending blocks may need more than one outbuf */
+        do {
+            ret = lzop_deflate(&this->strm, LZOP_FLUSH);
+            // PD("D [close](out) deflate_end:"<< ret << "avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+            if (this->strm.avail_out != ZBUFSIZELZO_OUT) {
+                size_t write_size = ZBUFSIZELZO_OUT - this->strm.avail_out;
+                this->io->write((char*)(this->outbuf), write_size);
+                this->strm.avail_out = ZBUFSIZELZO_OUT;
+                this->strm.next_out = this->outbuf;
+            }
+        } while (LZOP_OK == ret);
         ret = lzop_deflateEnd(&this->strm);
         PD("D [close](out) deflate_end:"<< ret << "avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
     }else{
         PD("D [close](in) inflate_end");
         (void)lzop_inflateEnd(&this->strm);
+        this->rafs.close();
     }
     ZFile::close();
 }
@@ -103,44 +137,30 @@ size_t ZFileLZO::write (const char* s, size_t n){
         // Error, Not possible to read here
         return 0;
     }
-    size_t s_offset = 0;
-
-    while (true) {
-        //PD("D 001 ZBUFSIZEXZ:"<<ZBUFSIZEXZ<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
-        if (this->strm.avail_in == 0 && 0 != n) {
-            size_t copy_size = ZBUFSIZELZO_IN > n ? n : ZBUFSIZELZO_IN;
-            std::memcpy(this->inbuf, s + s_offset, copy_size);
-            this->strm.avail_in = copy_size;
-            s_offset += copy_size;
-            n -= copy_size;
-        }
 
-        this->strm.next_in = this->inbuf;
-        this->strm.next_out = this->outbuf;
+    /* lzop_deflate reads straight from the caller's buffer */
+    this->strm.next_in = (uint8_t*)s;
+    this->strm.avail_in = n;
+    this->strm.next_out = this->outbuf;
 
-        PD("D 002 eof:"<<this->fs.eof()<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+    PD("D 002 eof:"<<this->io->eof()<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
 
-        while (this->strm.avail_in){
-            int ret = lzop_deflate(&strm, LZOP_NO_FLUSH);
-            PD("D 010 eof:"<<this->fs.eof()<<" lzo_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
-
-            if (ret != LZOP_OK) {
-                return 0;
-            }
+    while (this->strm.avail_in){
+        int ret = lzop_deflate(&strm, LZOP_NO_FLUSH);
+        PD("D 010 eof:"<<this->io->eof()<<" lzo_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
 
-            if (this->strm.avail_out != ZBUFSIZELZO_OUT) {
-                size_t write_size = ZBUFSIZELZO_OUT - this->strm.avail_out;
-                this->fs.write((char*)(this->outbuf), write_size);
-                this->strm.avail_out = ZBUFSIZELZO_OUT;
-                this->strm.next_out = this->outbuf;
-            }
+        if (ret != LZOP_OK) {
+            return 0;
         }
 
-        if (0 == n){
-            return s_offset;
+        if (this->strm.avail_out != ZBUFSIZELZO_OUT) {
+            size_t write_size = ZBUFSIZELZO_OUT - this->strm.avail_out;
+            this->io->write((char*)(this->outbuf), write_size);
+            this->strm.avail_out = ZBUFSIZELZO_OUT;
+            this->strm.next_out = this->outbuf;
         }
     }
-    return 0;
+    return n;
 }
 
 size_t ZFileLZO::read (char* s, size_t n){
@@ -161,48 +181,451 @@ size_t ZFileLZO::read (char* s, size_t n){
         s_offset += copy_size;
         n -= copy_size;
 
-        PD("D 001 eof:"<<this->fs.eof()<<" out_size:"<<out_size
+        PD("D 001 eof:"<<this->io->eof()<<" out_size:"<<out_size
            <<" copy_size:"<<copy_size<<" s_offset:"<<s_offset<<std::endl);
         PD("D 002 n:"<<n<<" avail_in:"<<this->strm.avail_in<<" avail_out"<<this->strm.avail_out<<std::endl);
-        if (0 == n || (this->fs.eof() && 0 == this->strm.avail_in) || LZOP_STREAM_END == this->status){
+        if (0 == n){
+            this->pos += s_offset;
+            return s_offset;
+        }
+        if (n >= ZBUFSIZELZO_OUT){
+            /* the outbuf is empty, large reads are decoded straight into s */
+            size_t direct_size = n;
+            bool more = this->fill((uint8_t*)s + s_offset, direct_size);
+            direct_size -= this->strm.avail_out;
+            this->strm.next_out = this->outbuf;
+            this->strm.avail_out = ZBUFSIZELZO_OUT;
+            s_offset += direct_size;
+            n -= direct_size;
+            if (!more){
+                this->pos += s_offset;
+                return s_offset;
+            }
+        }else if (!this->fill()){
+            this->pos += s_offset;
             return s_offset;
         }
+    }
+    return 0;
+}
+
+/* the outbuf is empty, decode the next chunk; false when nothing else can be decoded */
+bool ZFileLZO::fill(){
+    return this->fill(this->outbuf, ZBUFSIZELZO_OUT);
+}
+
+/* decode into out, either the outbuf or the caller's buffer */
+bool ZFileLZO::fill(uint8_t *out, size_t size){
+    this->offsetbuf = 0;
+    this->strm.next_out = out;
+    this->strm.avail_out = size;
+    if (LZOP_STREAM_END == this->status){
+        return false;
+    }
+
+    PD("D 003 eof:"<<this->io->eof()<<std::endl);
+
+    if (this->strm.avail_in == 0 && !this->io->eof()) {
+         const uint8_t *next;
+        // read data as a block:
+         this->strm.avail_in = this->input(this->inbuf, ZBUFSIZELZO_IN, &next);
+         this->strm.next_in = (uint8_t*)next;
+
+         PD("D 004 eof:"<<this->io->eof()<<" in_len:"<<this->strm.avail_in<<std::endl);
+    }
+
+    this->status = lzop_inflate(&this->strm);
+
+    PD("D 009 eof:"<<this->io->eof()<<" in_len:"<< this->strm.avail_out <<std::endl);
+    PD("D 010 eof:"<<this->io->eof()<<" lzma_ret:"<<this->status<<std::endl);
+
+    switch (this->status) {
+        case LZOP_OK:
+            if (size == this->strm.avail_out && 0 == this->strm.avail_in && this->io->eof()){
+                /* truncated stream, nothing else can be decoded */
+                return false;
+            }
+            return true;
+        case LZOP_STREAM_END:
+            return true;
+        case LZOP_ERROR:
+        case LZOP_CORRUPTED_DATA:
+            throw "Inflate Error!";
+    }
+    return true;
+}
+
+size_t ZFileLZO::peek(const char** s){
+    size_t out_size = 0;
+    if (this->mode == std::ios_base::in){
+        while (0 == (out_size = ZBUFSIZELZO_OUT - this->strm.avail_out - this->offsetbuf) && this->fill());
+    }
+    *s = (const char*)(this->outbuf + this->offsetbuf);
+    return out_size;
+}
+
+void ZFileLZO::consume(size_t n){
+    size_t out_size = ZBUFSIZELZO_OUT - this->strm.avail_out - this->offsetbuf;
+    n = n > out_size ? out_size : n;
+    this->offsetbuf += n;
+    this->pos += n;
+}
+
+uint64_t ZFileLZO::tell() const{
+    return this->pos;
+}
+
+std::vector<char> ZFileLZO::compress(const char* s, size_t n, const ZFileLZO::options &opt){
+    lzop_stream ls = {};
+    lzop_options lopt = {};
+    lopt.level = opt.level;
+    lopt.method = opt.method;
+    lopt.check = opt.chk;
+    lopt.block_size = opt.block_size;
+    if (LZOP_OK != lzop_deflateInit2(&ls, &lopt)){
+        std::cerr << "Error initializing the encoder!\n";
+        throw "Encoder Not initialized!";
+    }
+    std::vector<char> out(lzop_deflateBound(&ls, n));
+    ls.next_in = (uint8_t*)s;
+    ls.avail_in = n;
+    ls.next_out = (uint8_t*)out.data();
+    ls.avail_out = out.size();
+    LZOP_STATUS ret = lzop_deflate(&ls, LZOP_FLUSH);
+    out.resize(out.size() - ls.avail_out);
+    (void)lzop_deflateEnd(&ls);
+    if (LZOP_STREAM_END != ret){
+        std::cerr << "Deflate error: " << ret << "\n";
+        throw "Deflate Error!";
+    }
+    PD("D [compress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+std::vector<char> ZFileLZO::decompress(const char* s, size_t n){
+    lzop_stream hs = {};
+    if (LZOP_OK != lzop_inflateInit(&hs)){
+        std::cerr << "Error initializing the decoder!\n";
+        throw "Decoder Not initialized!";
+    }
+    size_t offset;
+    try {
+        offset = readHeader(&hs, (uint8_t*)s, n);
+    } catch (...) {
+        (void)lzop_inflateEnd(&hs);
+        throw;
+    }
+    size_t descsize = lzop_inflateBlockDescSize(&hs);
+    size_t chksize = lzop_inflateBlockChkSize(&hs);
+    (void)lzop_inflateEnd(&hs);
+
+    std::vector<block> blocks;
+    uint64_t length = 0;
+    while (true) {
+        block b = {offset, length, 0, 0};
+        /* the end marker is just a zero src_len */
+        if (n - offset >= 4 && 0 == *(uint32_t*)(s + offset)){
+            break;
+        }
+        LZOP_STATUS ret = n - offset < descsize ? LZOP_CORRUPTED_DATA :
+                          lzop_inflateBlockDesc((const uint8_t*)s + offset, &b.src_len, &b.dst_len);
+        offset += descsize + (b.dst_len < b.src_len ? chksize : 0) + b.dst_len;
+        if (LZOP_OK != ret || offset > n){
+            std::cerr << "Corrupted or truncated block at " << b.in << "\n";
+            throw "Inflate Error!";
+        }
+        blocks.push_back(b);
+        length += b.src_len;
+    }
+
+    /* the descriptors can claim anything: trusted up to 256:1, the output grows beyond */
+    std::vector<char> out;
+    out.reserve(length / 256 > n ? n * 256 : length);
+    for (const block &b : blocks){
+        const uint8_t *in = (const uint8_t*)s + b.in + descsize + (b.dst_len < b.src_len ? chksize : 0);
+        out.resize(b.out + b.src_len);
+        if (LZOP_OK != lzop_inflateBlock(in, b.dst_len, (uint8_t*)out.data() + b.out, b.src_len)){
+            std::cerr << "Error decoding the block at " << b.in << "\n";
+            throw "Inflate Error!";
+        }
+    }
+    PD("D [decompress] blocks:"<<blocks.size()<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+/* feed the file header to the stream, returns its size */
+/* magic + 38 bytes + filter + name + chk are always below 512 */
+size_t ZFileLZO::readHeader(lzop_streamp strm, uint8_t *buf, size_t size){
+    strm->next_in = buf;
+    strm->avail_in = size;
+    if (LZOP_STREAM_END != lzop_inflateHeader(strm)){
+        std::cerr << "Error reading the lzop header!\n";
+        throw "Inflate Error!";
+    }
+    size -= strm->avail_in;
+    strm->next_in = nullptr;
+    strm->avail_in = 0;
+    return size;
+}
+
+/* the block holding the uncompressed offset */
+size_t ZFileLZO::blockAt(uint64_t offset) const{
+    size_t lo = 0, hi = this->index.size();
+    while (hi - lo > 1){
+        size_t mid = (lo + hi) / 2;
+        if (this->index[mid].out <= offset){
+            lo = mid;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* offset of the block data, after the descriptor */
+uint64_t ZFileLZO::dataAt(const block &b) const{
+    return b.in + this->descsize + (b.dst_len < b.src_len ? this->chksize : 0);
+}
+
+void ZFileLZO::buildIndex(){
+    std::ifstream in(this->filename, std::ifstream::binary);
+    lzop_stream hs = {};
+    if (!in || LZOP_OK != lzop_inflateInit(&hs)){
+        std::cerr << "Error initializing the index decoder!\n";
+        throw "Index Not built!";
+    }
+    uint8_t buf[512];
+    in.read((char*)buf, sizeof(buf));
+    uint64_t offset = readHeader(&hs, buf, in.gcount());
+    this->descsize = lzop_inflateBlockDescSize(&hs);
+    this->chksize = lzop_inflateBlockChkSize(&hs);
+    (void)lzop_inflateEnd(&hs);
+
+    std::vector<uint8_t> desc(this->descsize);
+    uint64_t out = 0;
+    this->index.clear();
+    while (true) {
+        std::fill(desc.begin(), desc.end(), 0);
+        in.clear();
+        in.seekg(offset);
+        in.read((char*)desc.data(), desc.size());
+        size_t size = in.gcount();
+        block b;
+        b.in = offset;
+        b.out = out;
+        /* a short read is either the end marker or a truncated stream */
+        LZOP_STATUS ret = size < 4 ? LZOP_STREAM_END : lzop_inflateBlockDesc(desc.data(), &b.src_len, &b.dst_len);
+        if (LZOP_STREAM_END == ret || size < desc.size()){
+            break;
+        }
+        if (LZOP_OK != ret){
+            std::cerr << "Corrupted block descriptor at " << offset << "\n";
+            throw "Index Not built!";
+        }
+        this->index.push_back(b);
+        offset = this->dataAt(b) + b.dst_len;
+        out += b.src_len;
+    }
+    PD("D [buildIndex] blocks:"<<this->index.size()<<" length:"<<out<<std::endl);
+    this->length = out;
+    this->indexed = true;
+}
 
-        /* the outbuf is empty and we need to fetch more data */
+bool ZFileLZO::seek(uint64_t offset){
+    if (this->mode != std::ios_base::in){
+        return false;
+    }
+    if (!this->indexed){
+        this->buildIndex();
+    }
+    if (offset > this->length){
+        return false;
+    }
+
+    if (offset == this->length){
+        /* at the end, nothing left to decode */
+        this->status = LZOP_STREAM_END;
+        this->pos = offset;
         this->offsetbuf = 0;
-        this->strm.next_out = this->outbuf;        
+        this->strm.next_out = this->outbuf;
         this->strm.avail_out = ZBUFSIZELZO_OUT;
+        return true;
+    }
 
-        PD("D 003 eof:"<<this->fs.eof()<<std::endl);
+    /* already in the block and before the offset, just go on decoding */
+    size_t target = this->blockAt(offset);
+    if (offset < this->pos || LZOP_STREAM_END == this->status ||
+        this->pos >= this->length || this->blockAt(this->pos) != target){
+        if (0 == lzop_inflateBlockDescSize(&this->strm)){
+            uint8_t buf[512];
+            this->io->seek(0);
+            readHeader(&this->strm, buf, this->io->read((char*)buf, sizeof(buf)));
+        }
+        this->io->seek(this->index[target].in);
+        (void)lzop_inflateReset(&this->strm);
+        this->strm.next_in = this->inbuf;
+        this->strm.avail_in = 0;
+        this->strm.next_out = this->outbuf;
+        this->strm.avail_out = ZBUFSIZELZO_OUT;
+        this->offsetbuf = 0;
+        this->status = LZOP_OK;
+        this->pos = this->index[target].out;
+    }
 
-        if (this->strm.avail_in == 0 && !this->fs.eof()) {
-             this->strm.next_in = this->inbuf;
-            // read data as a block:
-             this->fs.read((char*)(this->inbuf), ZBUFSIZELZO_IN);
+    PD("D [seek] offset:"<<offset<<" from:"<<this->pos<<std::endl);
+    while (this->pos < offset){
+        const char *p;
+        size_t n = this->peek(&p);
+        if (0 == n){
+            return false;
+        }
+        this->consume(offset - this->pos > n ? n : offset - this->pos);
+    }
+    return true;
+}
 
-             if (this->fs){
-                 this->strm.avail_in = ZBUFSIZELZO_IN;
-             }else{
-                 this->strm.avail_in = this->fs.gcount();
-             }
+size_t ZFileLZO::readAt(uint64_t offset, char* s, size_t n){
+    if (this->mode != std::ios_base::in){
+        return 0;
+    }
+    if (!this->indexed){
+        this->buildIndex();
+    }
+    if (!this->rafs.is_open()){
+        this->rafs.open(this->filename, std::ifstream::binary);
+        if (this->opt.verify){
+            /* the header flags tell which checksums follow the descriptors */
+            lzop_stream hs = {};
+            if (!this->rafs || LZOP_OK != lzop_inflateInit(&hs)){
+                std::cerr << "Error initializing the block decoder!\n";
+                throw "Decoder Not initialized!";
+            }
+            uint8_t buf[512];
+            this->rafs.read((char*)buf, sizeof(buf));
+            readHeader(&hs, buf, this->rafs.gcount());
+            this->raflags = lzop_inflateBlockFlags(&hs);
+            (void)lzop_inflateEnd(&hs);
+        }
+    }
 
-             PD("D 004 eof:"<<this->fs.eof()<<" in_len:"<<this->strm.avail_in<<std::endl);
+    size_t s_offset = 0;
+    while (0 != n && offset < this->length){
+        size_t i = this->blockAt(offset);
+        const block &b = this->index[i];
+        if (i != this->rablock){
+            /* the descriptor and its checksums come along for opt.verify */
+            size_t head = this->dataAt(b) - b.in;
+            this->rain.resize(head + b.dst_len);
+            this->racache.resize(b.src_len);
+            this->rafs.clear();
+            this->rafs.seekg(b.in);
+            this->rafs.read((char*)this->rain.data(), this->rain.size());
+            this->rablock = SIZE_MAX;
+            const uint8_t *in = this->rain.data() + head;
+            if (!this->rafs || LZOP_OK != (this->opt.verify ?
+                    lzop_inflateBlockVerify(this->rain.data(), this->raflags, in, b.dst_len, this->racache.data(), b.src_len) :
+                    lzop_inflateBlock(in, b.dst_len, this->racache.data(), b.src_len))){
+                std::cerr << "Error decoding the block at " << b.in << "\n";
+                throw "Inflate Error!";
+            }
+            this->rablock = i;
         }
+        size_t skip = offset - b.out;
+        size_t copy_size = b.src_len - skip > n ? n : b.src_len - skip;
+        std::memcpy(s + s_offset, this->racache.data() + skip, copy_size);
+        s_offset += copy_size;
+        offset += copy_size;
+        n -= copy_size;
+    }
+    return s_offset;
+}
 
-        this->status = lzop_inflate(&this->strm);
+/*
+ * Sidecar index: magic, compressed size (to spot a stale index),
+ * descriptor and checksums sizes, uncompressed length, count and the blocks.
+ */
+static const char ZLZO_INDEX_MAGIC[8] = {'Z','L','Z','O','I','D','X','2'};
 
-        PD("D 009 eof:"<<this->fs.eof()<<" in_len:"<< this->strm.avail_out <<std::endl);
-        PD("D 010 eof:"<<this->fs.eof()<<" lzma_ret:"<<this->status<<std::endl);
+void ZFileLZO::saveIndex(const char* filename){
+    if (!this->indexed){
+        this->buildIndex();
+    }
+    std::ifstream in(this->filename, std::ifstream::binary | std::ifstream::ate);
+    uint64_t size = in.tellg();
+    uint64_t descsize = this->descsize;
+    uint64_t chksize = this->chksize;
+    uint64_t count = this->index.size();
+    std::ofstream idx(filename, std::ofstream::binary);
+    idx.write(ZLZO_INDEX_MAGIC, sizeof(ZLZO_INDEX_MAGIC));
+    idx.write((const char*)&size, sizeof(size));
+    idx.write((const char*)&descsize, sizeof(descsize));
+    idx.write((const char*)&chksize, sizeof(chksize));
+    idx.write((const char*)&this->length, sizeof(this->length));
+    idx.write((const char*)&count, sizeof(count));
+    idx.write((const char*)this->index.data(), count * sizeof(block));
+    if (!idx){
+        std::cerr << "Error writing the index " << filename << "\n";
+        throw "Index Not saved!";
+    }
+}
 
-        switch (this->status) {
-            case LZOP_OK:
-            case LZOP_STREAM_END:
-                continue;
-            case LZOP_ERROR:
-            case LZOP_CORRUPTED_DATA:
-                throw "Inflate Error!";
-                return 0;
+bool ZFileLZO::loadIndex(const char* filename){
+    std::ifstream idx(filename, std::ifstream::binary | std::ifstream::ate);
+    std::ifstream in(this->filename, std::ifstream::binary | std::ifstream::ate);
+    uint64_t idxsize = idx ? (uint64_t)idx.tellg() : 0;
+    idx.seekg(0);
+    char magic[sizeof(ZLZO_INDEX_MAGIC)];
+    uint64_t size = 0, descsize = 0, chksize = 0, length = 0, count = 0;
+    idx.read(magic, sizeof(magic));
+    idx.read((char*)&size, sizeof(size));
+    idx.read((char*)&descsize, sizeof(descsize));
+    idx.read((char*)&chksize, sizeof(chksize));
+    idx.read((char*)&length, sizeof(length));
+    idx.read((char*)&count, sizeof(count));
+    if (!idx || std::memcmp(magic, ZLZO_INDEX_MAGIC, sizeof(magic)) ||
+        size != (uint64_t)in.tellg()){
+        PD("D [loadIndex] missing or stale index:"<<filename<<std::endl);
+        return false;
+    }
+    if ((descsize != 2 * 4 && descsize != 3 * 4) || (chksize != 0 && chksize != 4) ||
+        count > (idxsize - (uint64_t)idx.tellg()) / sizeof(block)){
+        PD("D [loadIndex] corrupted index:"<<filename<<std::endl);
+        return false;
+    }
+    std::vector<block> index(count);
+    idx.read((char*)index.data(), count * sizeof(block));
+    if (!idx){
+        return false;
+    }
+    /* the blocks must be the ones lzop_inflateBlockDesc() would accept, one after the other */
+    uint64_t in_end = 0;
+    uint64_t out_end = 0;
+    for (const block &b : index){
+        uint8_t desc[8] = {
+            (uint8_t)(b.src_len >> 24), (uint8_t)(b.src_len >> 16), (uint8_t)(b.src_len >> 8), (uint8_t)b.src_len,
+            (uint8_t)(b.dst_len >> 24), (uint8_t)(b.dst_len >> 16), (uint8_t)(b.dst_len >> 8), (uint8_t)b.dst_len
+        };
+        uint32_t src_len, dst_len;
+        if (LZOP_OK != lzop_inflateBlockDesc(desc, &src_len, &dst_len) ||
+            b.in < in_end || b.in > size || b.out != out_end){
+            PD("D [loadIndex] corrupted index:"<<filename<<" block at:"<<b.in<<std::endl);
+            return false;
+        }
+        in_end = b.in + descsize + (b.dst_len < b.src_len ? chksize : 0) + b.dst_len;
+        out_end += b.src_len;
+        if (in_end > size){
+            PD("D [loadIndex] corrupted index:"<<filename<<" block at:"<<b.in<<std::endl);
+            return false;
         }
     }
-    return 0;
+    if (out_end != length){
+        return false;
+    }
+    this->index = std::move(index);
+    this->descsize = descsize;
+    this->chksize = chksize;
+    this->length = length;
+    this->indexed = true;
+    this->rablock = SIZE_MAX;
+    return true;
 }
@@ -33,6 +33,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <vector>
 
 #include <zutil/zfilexz.h>
 
@@ -63,7 +64,8 @@ std::string hexStr(unsigned char *data, int len)
 #endif
 
 ZFileXZ::ZFileXZ(const ZFileXZ::options &opt)
-    :inbuf(nullptr), outbuf(nullptr), filters(nullptr), opt(opt)
+    :inbuf(nullptr), outbuf(nullptr), filters(nullptr), opt(opt),
+     index(nullptr), blockmode(false), pos(0)
 {
     this->inbuf = new uint8_t[ZBUFSIZEXZ];
     this->outbuf = new uint8_t[ZBUFSIZEXZ];
@@ -76,7 +78,8 @@ ZFileXZ::ZFileXZ(const ZFileXZ::options &opt)
 }
 
 ZFileXZ::ZFileXZ()
-    : inbuf(nullptr), outbuf(nullptr), filters(nullptr)
+    : inbuf(nullptr), outbuf(nullptr), filters(nullptr),
+      index(nullptr), blockmode(false), pos(0)
 {
     this->inbuf = new uint8_t[ZBUFSIZEXZ];
     this->outbuf = new uint8_t[ZBUFSIZEXZ];
@@ -91,6 +94,7 @@ ZFileXZ::ZFileXZ()
 
 ZFileXZ::~ZFileXZ(){
     lzma_end(&this->strm);
+    lzma_index_end(this->index, nullptr);
     if (this->inbuf)   delete[] this->inbuf;
     if (this->outbuf)  delete[] this->outbuf;
     if (this->filters) delete[] this->filters;
@@ -111,11 +115,95 @@ void ZFileXZ::_free(void *opaque, void *ptr){
 }
 #endif
 
+/* the filter chain for the options, filters has room for 3 of them */
+lzma_filter * ZFileXZ::filterChain(const ZFileXZ::options &opt, lzma_options_lzma *opt_lzma2, lzma_filter *filters){
+    if (lzma_lzma_preset(opt_lzma2, opt.preset)) {
+        std::cerr << "Unsupported preset, possibly a bug" << std::endl;
+        throw "Unsupported preset, possibly a bug";
+    }
+    if (opt.dict_size != LZMA_DICT_SIZE_DEFAULT){
+        opt_lzma2->dict_size = opt.dict_size;
+    }
+    if (opt.mode != options::mode_preset){
+        opt_lzma2->mode = (lzma_mode)opt.mode;
+    }
+    if (opt.mf != options::mf_preset){
+        opt_lzma2->mf = (lzma_match_finder)opt.mf;
+    }
+    if (opt.nice_len){
+        opt_lzma2->nice_len = opt.nice_len;
+    }
+    if (opt.depth){
+        opt_lzma2->depth = opt.depth;
+    }
+
+    /*
+     * TODO:
+     * FIX this HUGE amount of CRAP!!!
+     */
+    filters[0].id = LZMA_VLI_UNKNOWN;
+    filters[0].options = nullptr;
+    filters[1].id = LZMA_FILTER_LZMA2;
+    filters[1].options = opt_lzma2;
+    filters[2].id = LZMA_VLI_UNKNOWN;
+    filters[2].options = nullptr;
+
+    lzma_filter * pfilters = &filters[0];
+
+    switch( opt.filter){
+        case options::lzma2:
+            pfilters = &filters[1];
+            break;
+        case options::arm:
+            filters[0].id = LZMA_FILTER_ARM;
+            filters[0].options = nullptr;
+            break;
+        case options::x86:
+            filters[0].id = LZMA_FILTER_X86;
+            filters[0].options = nullptr;
+            break;
+
+//            default:
+//                pfilters = &filters[1];
+//                break;
+
+    }
+    return pfilters;
+}
+
 void ZFileXZ::open(const char* filename, std::ios_base::openmode mode){
     ZFile::open(filename, mode);
     if (this->mode == std::ios_base::in){
-        lzma_ret ret = lzma_stream_decoder(
+        uint32_t threads = this->opt.threads;
+        if (0 == threads){
+            threads = lzma_cputhreads();
+        }
+
+        lzma_ret ret;
+#if LZMA_VERSION >= 50040002 /* 5.4.0 */
+        if (threads > 1){
+            /*
+             * Multi-block files (xz -T, or threads > 1 here) are decoded
+             * one block per thread, single block files still use one thread
+             */
+            uint64_t memlimit = this->opt.memlimit;
+            if (0 == memlimit){
+                memlimit = lzma_physmem() / 4;
+            }
+            lzma_mt mt = {};
+            mt.flags = LZMA_CONCATENATED;
+            mt.threads = threads;
+            mt.timeout = 0;
+            mt.memlimit_threading = memlimit ? memlimit : UINT64_MAX;
+            mt.memlimit_stop = UINT64_MAX;
+            PD("D threads:"<<mt.threads<<" memlimit:"<<mt.memlimit_threading<<std::endl);
+            ret = lzma_stream_decoder_mt(&this->strm, &mt);
+        }else
+#endif
+        {
+            ret = lzma_stream_decoder(
                 &this->strm, UINT64_MAX, LZMA_CONCATENATED);
+        }
 
         if (ret != LZMA_OK){
             const char *msg;
@@ -137,6 +225,10 @@ void ZFileXZ::open(const char* filename, std::ios_base::openmode mode){
         this->offsetbuf = 0;
         this->action = LZMA_RUN;
         this->status = LZMA_OK;
+        this->blockmode = false;
+        this->pos = 0;
+        lzma_index_end(this->index, nullptr);
+        this->index = nullptr;
         this->strm.next_in = nullptr;
         this->strm.avail_in = 0;
         this->strm.next_out = this->outbuf;
@@ -145,44 +237,8 @@ void ZFileXZ::open(const char* filename, std::ios_base::openmode mode){
     if (this->mode == std::ios_base::out){
         PD("D preset:"<<this->opt.preset<<" dict:"<<this->opt.dict_size<<std::endl);
 
-        if (lzma_lzma_preset(&this->opt_lzma2, this->opt.preset)) {
-            std::cerr << "Unsupported preset, possibly a bug" << std::endl;
-            throw "Unsupported preset, possibly a bug";
-        }
-        if (this->opt.dict_size != LZMA_DICT_SIZE_DEFAULT){
-            this->opt_lzma2.dict_size = this->opt.dict_size;
-        }
-
-        /*
-         * TODO:
-         * FIX this HUGE amount of CRAP!!!
-         */
-        lzma_filter filters[] = {
-            { .id = LZMA_VLI_UNKNOWN,  .options = nullptr },
-            { .id = LZMA_FILTER_LZMA2, .options = &this->opt_lzma2 },
-            { .id = LZMA_VLI_UNKNOWN,  .options = nullptr }
-        };
-
-        lzma_filter * pfilters = &filters[0];
-
-        switch( this->opt.filter){
-            case options::lzma2:
-                pfilters = &filters[1];
-                break;
-            case options::arm:
-                filters[0].id = LZMA_FILTER_ARM;
-                filters[0].options = nullptr;
-                break;
-            case options::x86:
-                filters[0].id = LZMA_FILTER_X86;
-                filters[0].options = nullptr;
-                break;
-
-//            default:
-//                pfilters = &filters[1];
-//                break;
-
-        }
+        lzma_filter filters[3];
+        lzma_filter * pfilters = ZFileXZ::filterChain(this->opt, &this->opt_lzma2, filters);
 
         // Initialize the encoder using the custom filter chain.
         lzma_check chk = LZMA_CHECK_NONE;
@@ -200,7 +256,28 @@ void ZFileXZ::open(const char* filename, std::ios_base::openmode mode){
                 chk = LZMA_CHECK_SHA256;
                 break;
         }
-        lzma_ret ret = lzma_stream_encoder(&this->strm, pfilters, chk);
+        uint32_t threads = this->opt.threads;
+        if (0 == threads){
+            threads = lzma_cputhreads();
+        }
+
+        lzma_ret ret;
+        if (threads > 1){
+            /*
+             * The input is split in blocks compressed in parallel,
+             * the result is still a standard single stream .xz file
+             */
+            lzma_mt mt = {};
+            mt.threads = threads;
+            mt.block_size = this->opt.block_size;
+            mt.timeout = 0;
+            mt.filters = pfilters;
+            mt.check = chk;
+            PD("D threads:"<<mt.threads<<" block_size:"<<mt.block_size<<std::endl);
+            ret = lzma_stream_encoder_mt(&this->strm, &mt);
+        }else{
+            ret = lzma_stream_encoder(&this->strm, pfilters, chk);
+        }
 
         if (ret != LZMA_OK){
             const char *msg;
@@ -239,14 +316,18 @@ void ZFileXZ::open(const char* filename, std::ios_base::openmode mode){
 
 void ZFileXZ::close(){
     if (this->mode == std::ios_base::out){
-        this->strm.next_in = this->inbuf;
-        this->strm.next_out = this->outbuf;
-        lzma_ret ret = lzma_code(&this->strm, LZMA_FINISH);
-        if (this->strm.avail_out != ZBUFSIZEXZ || ret == LZMA_STREAM_END) {
-            size_t write_size = ZBUFSIZEXZ - this->strm.avail_out;
-            this->fs.write((char*)(this->outbuf), write_size);
-        }
-        PD("D [close](out)"<<std::endl);
+        lzma_ret ret;
+        /* the encoder may hold more than one outbuf of data */
+        do {
+            this->strm.next_out = this->outbuf;
+            this->strm.avail_out = ZBUFSIZEXZ;
+            ret = lzma_code(&this->strm, LZMA_FINISH);
+            if (this->strm.avail_out != ZBUFSIZEXZ) {
+                size_t write_size = ZBUFSIZEXZ - this->strm.avail_out;
+                this->io->write((char*)(this->outbuf), write_size);
+            }
+        } while (ret == LZMA_OK);
+        PD("D [close](out) ret:"<<ret<<std::endl);
     }else{
         PD("D [close](in)"<<std::endl);
     }
@@ -264,37 +345,26 @@ size_t ZFileXZ::write (const char* s, size_t n){
         return 0;
     }
 
-    size_t s_offset = 0;
+    /* lzma_code reads straight from the caller's buffer */
+    this->strm.next_in = (const uint8_t*)s;
+    this->strm.avail_in = n;
 
-    while (true) {
-        //PD("D 001 ZBUFSIZEXZ:"<<ZBUFSIZEXZ<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
-        if (this->strm.avail_in == 0 && 0 != n) {
-            size_t copy_size = ZBUFSIZEXZ > n ? n : ZBUFSIZEXZ;
-            std::memcpy(this->inbuf, s + s_offset, copy_size);
-            this->strm.avail_in = copy_size;
-            s_offset += copy_size;
-            n -= copy_size;
-        }
-
-        this->strm.next_in = this->inbuf;
+    while (this->strm.avail_in) {
         this->strm.next_out = this->outbuf;
 
-        PD("D 002 n:"<<n<<" eof:"<<this->fs.eof()<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+        PD("D 002 eof:"<<this->io->eof()<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
         lzma_ret ret = lzma_code(&this->strm, LZMA_RUN);
-        PD("D 010 n:"<<n<<" eof:"<<this->fs.eof()<<" lzma_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+        PD("D 010 eof:"<<this->io->eof()<<" lzma_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
 
         if (this->strm.avail_out != ZBUFSIZEXZ || ret == LZMA_STREAM_END) {
             size_t write_size = ZBUFSIZEXZ - this->strm.avail_out;
-            this->fs.write((char*)(this->outbuf), write_size);
+            this->io->write((char*)(this->outbuf), write_size);
             this->strm.avail_out = ZBUFSIZEXZ;
         }
 
-        if (0 == n)
-            return s_offset;
-
         if (ret != LZMA_OK) {
             if (ret == LZMA_STREAM_END)
-                return s_offset;
+                return n - this->strm.avail_in;
 
             const char *msg;
             switch (ret) {
@@ -322,6 +392,7 @@ size_t ZFileXZ::write (const char* s, size_t n){
             throw "Deflate Error!";
         }
     }
+    return n;
 }
 
 /*
@@ -353,81 +424,344 @@ size_t ZFileXZ::read (char* s, size_t n){
         s_offset += copy_size;
         n -= copy_size;
 
-        PD("D 001 eof:"<<this->fs.eof()<<" out_size:"<<out_size
+        PD("D 001 eof:"<<this->io->eof()<<" out_size:"<<out_size
            <<" copy_size:"<<copy_size<<" s_offset:"<<s_offset<<std::endl);
 
-        if (0 == n || LZMA_STREAM_END == this->status ){
+        if (0 == n){
+            this->pos += s_offset;
+            return s_offset;
+        }
+        if (n >= ZBUFSIZEXZ){
+            /* the outbuf is empty, large reads are decoded straight into s */
+            size_t direct_size = n;
+            bool more = this->fill((uint8_t*)s + s_offset, direct_size);
+            direct_size -= this->strm.avail_out;
+            this->strm.next_out = this->outbuf;
+            this->strm.avail_out = ZBUFSIZEXZ;
+            s_offset += direct_size;
+            n -= direct_size;
+            if (!more){
+                this->pos += s_offset;
+                return s_offset;
+            }
+        }else if (!this->fill()){
+            this->pos += s_offset;
             return s_offset;
         }
+    }
+}
 
-        /* the outbuf is empty and we need to fetch more data */
-        this->offsetbuf = 0;
-        this->strm.next_out = this->outbuf;
-        this->strm.avail_out = ZBUFSIZEXZ;
+/* the outbuf is empty, decode the next chunk; false when nothing else can be decoded */
+bool ZFileXZ::fill(){
+    return this->fill(this->outbuf, ZBUFSIZEXZ);
+}
 
-        PD("D 003 eof:"<<this->fs.eof()<<std::endl);
+/* decode into out, either the outbuf or the caller's buffer */
+bool ZFileXZ::fill(uint8_t *out, size_t size){
+    this->offsetbuf = 0;
+    this->strm.next_out = out;
+    this->strm.avail_out = size;
+    if (LZMA_STREAM_END == this->status){
+        return false;
+    }
 
-        if (this->strm.avail_in == 0 && !this->fs.eof()) {
-            this->strm.next_in = this->inbuf;
-             // read data as a block:
-             this->fs.read((char*)(this->inbuf), ZBUFSIZEXZ);
+    PD("D 003 eof:"<<this->io->eof()<<std::endl);
 
-             if (this->fs){
-                 this->strm.avail_in = ZBUFSIZEXZ;
-             }else{
-                 this->strm.avail_in = this->fs.gcount();
-             }
+    if (this->strm.avail_in == 0 && !this->io->eof()) {
+         // read data as a block:
+         this->strm.avail_in = this->input(this->inbuf, ZBUFSIZEXZ, &this->strm.next_in);
 
-             PD("D 004 eof:"<<this->fs.eof()<<" avail_in:"<<this->strm.avail_in<<std::endl);
+         PD("D 004 eof:"<<this->io->eof()<<" avail_in:"<<this->strm.avail_in<<std::endl);
 
-            if (this->fs.eof())
-                this->action = LZMA_FINISH;
-        }
+        if (this->io->eof())
+            this->action = LZMA_FINISH;
+    }
 
-        // PD("D 010 eof:"<<hexStr((unsigned char *)this->strm.next_in,this->strm.avail_in)<<std::endl);
-        PD("D 009 eof:"<<this->fs.eof()<<" lzma_ret:X avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
-        lzma_ret ret = lzma_code(&this->strm, this->action);
-        PD("D 010 eof:"<<this->fs.eof()<<" lzma_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
-        // PD("D 010 eof:"<<hexStr((unsigned char *)this->outbuf,ZBUFSIZEXZ-this->strm.avail_out)<<std::endl);
+    // PD("D 010 eof:"<<hexStr((unsigned char *)this->strm.next_in,this->strm.avail_in)<<std::endl);
+    PD("D 009 eof:"<<this->io->eof()<<" lzma_ret:X avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+    lzma_ret ret = lzma_code(&this->strm, this->action);
+    PD("D 010 eof:"<<this->io->eof()<<" lzma_ret:"<<ret<<" avail_in:"<<this->strm.avail_in<<" avail_out:"<<this->strm.avail_out<<std::endl);
+    // PD("D 010 eof:"<<hexStr((unsigned char *)this->outbuf,ZBUFSIZEXZ-this->strm.avail_out)<<std::endl);
+
+    if (ret == LZMA_STREAM_END && this->blockmode &&
+        !lzma_index_iter_next(&this->iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK)){
+        /* after a seek the blocks are decoded one by one */
+        if (!this->openBlock()){
+            std::cerr << "Inflate error: block " << this->iter.block.number_in_file << " not readable\n";
+            throw "Inflate Error!";
+        }
+        return true;
+    }
 
-        if (ret != LZMA_OK) {
-            if (ret == LZMA_STREAM_END || ret == LZMA_DATA_ERROR){
-                if (this->strm.avail_out > 0){
-                    this->status = LZMA_STREAM_END;
-                }
-                continue;
+    if (ret != LZMA_OK) {
+        if (ret == LZMA_STREAM_END || ret == LZMA_DATA_ERROR){
+            if (this->strm.avail_out > 0){
+                this->status = LZMA_STREAM_END;
             }
+            return true;
+        }
 
-            const char *msg;
-            switch (ret) {
-            case LZMA_MEM_ERROR:
-                msg = "Memory allocation failed";
-                break;
+        const char *msg;
+        switch (ret) {
+        case LZMA_MEM_ERROR:
+            msg = "Memory allocation failed";
+            break;
 
-            case LZMA_FORMAT_ERROR:
-                msg = "The input is not in the .xz format";
-                break;
+        case LZMA_FORMAT_ERROR:
+            msg = "The input is not in the .xz format";
+            break;
 
-            case LZMA_OPTIONS_ERROR:
-                msg = "Unsupported compression options";
-                break;
+        case LZMA_OPTIONS_ERROR:
+            msg = "Unsupported compression options";
+            break;
 
-            case LZMA_DATA_ERROR:
-                msg = "Compressed file is corrupt";
-                break;
+        case LZMA_DATA_ERROR:
+            msg = "Compressed file is corrupt";
+            break;
 
-            case LZMA_BUF_ERROR:
-                msg = "Compressed file is truncated or "
-                        "otherwise corrupt";
-                break;
+        case LZMA_BUF_ERROR:
+            msg = "Compressed file is truncated or "
+                    "otherwise corrupt";
+            break;
 
-            default:
-                msg = "Unknown error, possibly a bug";
-                break;
-            }
+        default:
+            msg = "Unknown error, possibly a bug";
+            break;
+        }
+
+        std::cerr << "Inflate error: " << msg << "(error code " << ret <<")\n" << std::endl;
+        throw "Inflate Error!";
+    }
+    return true;
+}
+
+size_t ZFileXZ::peek(const char** s){
+    size_t out_size = 0;
+    if (this->mode == std::ios_base::in){
+        while (0 == (out_size = ZBUFSIZEXZ - this->strm.avail_out - this->offsetbuf) && this->fill());
+    }
+    *s = (const char*)(this->outbuf + this->offsetbuf);
+    return out_size;
+}
+
+void ZFileXZ::consume(size_t n){
+    size_t out_size = ZBUFSIZEXZ - this->strm.avail_out - this->offsetbuf;
+    n = n > out_size ? out_size : n;
+    this->offsetbuf += n;
+    this->pos += n;
+}
+
+uint64_t ZFileXZ::tell() const{
+    return this->pos;
+}
 
-            std::cerr << "Inflate error: " << msg << "(error code " << ret <<")\n" << std::endl;
+std::vector<char> ZFileXZ::compress(const char* s, size_t n, const ZFileXZ::options &opt){
+    lzma_options_lzma opt_lzma2;
+    lzma_filter filters[3];
+    lzma_filter * pfilters = ZFileXZ::filterChain(opt, &opt_lzma2, filters);
+    std::vector<char> out(lzma_stream_buffer_bound(n));
+    size_t have = 0;
+    lzma_ret ret = lzma_stream_buffer_encode(pfilters, (lzma_check)opt.chk, nullptr,
+                                             (const uint8_t*)s, n, (uint8_t*)out.data(), &have, out.size());
+    if (LZMA_OK != ret){
+        std::cerr << "Deflate error: (error code " << ret << ")" << std::endl;
+        throw "Deflate Error!";
+    }
+    out.resize(have);
+    PD("D [compress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+/* the uncompressed size, walking the streams backwards by their indexes; 0 if unknown */
+static uint64_t uncompressedSize(const uint8_t *in, size_t size){
+    uint64_t total = 0;
+    while (size > 0){
+        /* stream padding, 4 null bytes at a time */
+        while (size >= 4 && 0 == (in[size - 4] | in[size - 3] | in[size - 2] | in[size - 1])){
+            size -= 4;
+        }
+        lzma_stream_flags footer;
+        if (size < 2 * LZMA_STREAM_HEADER_SIZE ||
+            LZMA_OK != lzma_stream_footer_decode(&footer, in + size - LZMA_STREAM_HEADER_SIZE) ||
+            footer.backward_size > size - 2 * LZMA_STREAM_HEADER_SIZE){
+            return 0;
+        }
+        lzma_index *index = nullptr;
+        uint64_t memlimit = UINT64_MAX;
+        size_t pos = 0;
+        if (LZMA_OK != lzma_index_buffer_decode(&index, &memlimit, nullptr,
+                in + size - LZMA_STREAM_HEADER_SIZE - footer.backward_size, &pos, footer.backward_size)){
+            return 0;
+        }
+        uint64_t stream = lzma_index_stream_size(index);
+        total += lzma_index_uncompressed_size(index);
+        lzma_index_end(index, nullptr);
+        if (stream > size){
+            return 0;
+        }
+        size -= stream;
+    }
+    return total;
+}
+
+std::vector<char> ZFileXZ::decompress(const char* s, size_t n){
+    lzma_stream zs = LZMA_STREAM_INIT;
+    if (LZMA_OK != lzma_stream_decoder(&zs, UINT64_MAX, LZMA_CONCATENATED)){
+        std::cerr << "Error initializing the decoder!" << std::endl;
+        throw "Decoder Not initialized!";
+    }
+    /* the indexes can claim anything: trusted up to 1024:1, the output grows beyond;
+     * one byte more: the same call gets to the index and the footer */
+    uint64_t size = uncompressedSize((const uint8_t*)s, n);
+    std::vector<char> out((size / 1024 > n ? n * 1024 : size) + 1);
+    size_t have = 0;
+    lzma_ret ret;
+    zs.next_in = (const uint8_t*)s;
+    zs.avail_in = n;
+    do {
+        if (have == out.size()){
+            out.resize(out.size() < ZBUFSIZEXZ ? ZBUFSIZEXZ : out.size() * 2);
+        }
+        zs.next_out = (uint8_t*)out.data() + have;
+        zs.avail_out = out.size() - have;
+        ret = lzma_code(&zs, LZMA_FINISH);
+        have = out.size() - zs.avail_out;
+    } while (LZMA_OK == ret);
+    lzma_end(&zs);
+    if (LZMA_STREAM_END != ret){
+        std::cerr << "Inflate error: (error code " << ret << ")" << std::endl;
+        throw "Inflate Error!";
+    }
+    out.resize(have);
+    PD("D [decompress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+/* load the index of all the streams, reading only the file tails */
+bool ZFileXZ::readIndex(){
+#if LZMA_VERSION >= 50040002 /* 5.4.0 */
+    std::ifstream in(this->filename, std::ifstream::binary | std::ifstream::ate);
+    uint64_t size = in.tellg();
+    in.seekg(0);
+
+    lzma_stream is = LZMA_STREAM_INIT;
+    if (!in || LZMA_OK != lzma_file_info_decoder(&is, &this->index, UINT64_MAX, size)){
+        return false;
+    }
+    std::vector<uint8_t> buf(0x10000);
+    lzma_ret ret;
+    do {
+        if (0 == is.avail_in){
+            in.read((char*)buf.data(), buf.size());
+            is.next_in = buf.data();
+            is.avail_in = in.gcount();
+        }
+        ret = lzma_code(&is, LZMA_RUN);
+        if (LZMA_SEEK_NEEDED == ret){
+            PD("D [readIndex] seek:"<<is.seek_pos<<std::endl);
+            in.clear();
+            in.seekg(is.seek_pos);
+            is.avail_in = 0;
+        }
+    } while (LZMA_OK == ret || LZMA_SEEK_NEEDED == ret);
+    lzma_end(&is);
+
+    if (LZMA_STREAM_END != ret){
+        PD("D [readIndex] error:"<<ret<<std::endl);
+        this->index = nullptr;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+/* start the block decoder on the block pointed by iter */
+bool ZFileXZ::openBlock(){
+    uint8_t header[LZMA_BLOCK_HEADER_SIZE_MAX];
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    lzma_block block = {};
+
+    this->io->seek(this->iter.block.compressed_file_offset);
+    if (1 != this->io->read((char*)header, 1) || 0 == header[0]){
+        return false;
+    }
+    block.version = 1;
+    block.check = this->iter.stream.flags->check;
+    block.filters = filters;
+    block.header_size = lzma_block_header_size_decode(header[0]);
+    if (block.header_size - 1 != this->io->read((char*)header + 1, block.header_size - 1) ||
+        LZMA_OK != lzma_block_header_decode(&block, nullptr, header)){
+        return false;
+    }
+
+    lzma_ret ret = lzma_block_compressed_size(&block, this->iter.block.unpadded_size);
+    if (LZMA_OK == ret){
+        ret = lzma_block_decoder(&this->strm, &block);
+    }
+    for (int i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++){
+        free(filters[i].options);
+    }
+    PD("D [openBlock] block:"<<this->iter.block.number_in_file<<" ret:"<<ret<<std::endl);
+
+    this->strm.next_in = this->inbuf;
+    this->strm.avail_in = 0;
+    this->action = LZMA_RUN;
+    return LZMA_OK == ret;
+}
+
+bool ZFileXZ::seek(uint64_t offset){
+    if (this->mode != std::ios_base::in){
+        return false;
+    }
+    if (nullptr == this->index && !this->readIndex()){
+        return false;
+    }
+    uint64_t length = lzma_index_uncompressed_size(this->index);
+    if (offset > length){
+        return false;
+    }
+
+    lzma_index_iter target;
+    lzma_index_iter_init(&target, this->index);
+    if (offset == length || lzma_index_iter_locate(&target, offset)){
+        /* at the end, nothing left to decode */
+        this->status = LZMA_STREAM_END;
+        this->pos = offset;
+        this->offsetbuf = 0;
+        this->strm.next_out = this->outbuf;
+        this->strm.avail_out = ZBUFSIZEXZ;
+        return true;
+    }
+
+    /* already in the block and before the offset, just go on decoding */
+    lzma_index_iter current;
+    lzma_index_iter_init(&current, this->index);
+    if (offset < this->pos || LZMA_STREAM_END == this->status ||
+        lzma_index_iter_locate(&current, this->pos) ||
+        current.block.number_in_file != target.block.number_in_file){
+        this->iter = target;
+        if (!this->openBlock()){
+            std::cerr << "Inflate error: block " << this->iter.block.number_in_file << " not readable\n";
             throw "Inflate Error!";
         }
+        this->blockmode = true;
+        this->status = LZMA_OK;
+        this->pos = this->iter.block.uncompressed_file_offset;
+        this->offsetbuf = 0;
+        this->strm.next_out = this->outbuf;
+        this->strm.avail_out = ZBUFSIZEXZ;
+    }
+
+    PD("D [seek] offset:"<<offset<<" from:"<<this->pos<<std::endl);
+    while (this->pos < offset){
+        const char *p;
+        size_t n = this->peek(&p);
+        if (0 == n){
+            return false;
+        }
+        this->consume(offset - this->pos > n ? n : offset - this->pos);
     }
+    return true;
 }
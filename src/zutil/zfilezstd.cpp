@@ -0,0 +1,402 @@
+/* zfilezstd.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <iostream>
+#include <cstring>
+#include <thread>
+
+#include <zutil/zfilezstd.h>
+
+#ifdef TEST_BUFFER
+#define ZBUFSIZEZSTD ( TEST_BUFFER )
+#else
+#define ZBUFSIZEZSTD (0x1000 * 0x80) /* 512k */
+#endif
+
+// #define DEBUG
+
+#ifdef DEBUG
+#define PD(_d) do { std::cout << " #(zstd) " << _d ;}while(0)
+#else
+#define PD(_d) do {;}while(0)
+#endif
+
+ZFileZSTD::ZFileZSTD(const ZFileZSTD::options &opt)
+    : cctx(nullptr), dctx(nullptr), in(), out(),
+      inbuf(nullptr), outbuf(nullptr), offsetbuf(0), end(false), hint(0), opt(opt), pos(0)
+{
+    this->inbuf = new uint8_t[ZBUFSIZEZSTD];
+    this->outbuf = new uint8_t[ZBUFSIZEZSTD];
+}
+
+ZFileZSTD::ZFileZSTD()
+    : cctx(nullptr), dctx(nullptr), in(), out(),
+      inbuf(nullptr), outbuf(nullptr), offsetbuf(0), end(false), hint(0), pos(0)
+{
+    this->inbuf = new uint8_t[ZBUFSIZEZSTD];
+    this->outbuf = new uint8_t[ZBUFSIZEZSTD];
+}
+
+ZFileZSTD::~ZFileZSTD(){
+    ZSTD_freeCCtx(this->cctx);
+    ZSTD_freeDCtx(this->dctx);
+    if (this->inbuf)  delete[] this->inbuf;
+    if (this->outbuf) delete[] this->outbuf;
+}
+
+/* reset the encoder to the options, an error code if any of them is refused */
+size_t ZFileZSTD::setParameters(ZSTD_CCtx *cctx, const ZFileZSTD::options &opt, uint32_t threads){
+    size_t ret = ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+    if (!ZSTD_isError(ret)){
+        ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, opt.level);
+    }
+    if (!ZSTD_isError(ret)){
+        ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, opt.checksum);
+    }
+    if (!ZSTD_isError(ret) && opt.long_distance){
+        ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, 1);
+    }
+    if (!ZSTD_isError(ret) && opt.window_log){
+        ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, opt.window_log);
+    }
+    if (!ZSTD_isError(ret) && threads > 1){
+        /* the input is split in jobs compressed in parallel, still a single frame */
+        ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, threads);
+    }
+    return ret;
+}
+
+/* sum of the content sizes of the frames, unknown if any of them does not record it */
+static unsigned long long contentSize(const char* s, size_t n){
+    unsigned long long size = 0;
+    while (n){
+        unsigned long long frame = ZSTD_getFrameContentSize(s, n);
+        size_t length = ZSTD_findFrameCompressedSize(s, n);
+        if (ZSTD_CONTENTSIZE_ERROR == frame || ZSTD_isError(length)){
+            return ZSTD_CONTENTSIZE_ERROR;
+        }
+        if (ZSTD_CONTENTSIZE_UNKNOWN == frame){
+            return ZSTD_CONTENTSIZE_UNKNOWN;
+        }
+        size += frame;
+        s += length;
+        n -= length;
+    }
+    return size;
+}
+
+std::vector<char> ZFileZSTD::compress(const char* s, size_t n, const ZFileZSTD::options &opt){
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    size_t ret = cctx ? ZFileZSTD::setParameters(cctx, opt, 1) : 0;
+    if (nullptr == cctx || ZSTD_isError(ret)){
+        std::cerr << "Error initializing the encoder: "
+                  << (cctx ? ZSTD_getErrorName(ret) : "Memory allocation failed") << std::endl;
+        ZSTD_freeCCtx(cctx);
+        throw "Encoder Not initialized!";
+    }
+    /* the frame header records n, decompress() reads it back */
+    std::vector<char> out(ZSTD_compressBound(n));
+    ret = ZSTD_compress2(cctx, out.data(), out.size(), s, n);
+    ZSTD_freeCCtx(cctx);
+    if (ZSTD_isError(ret)){
+        std::cerr << "Deflate error: " << ZSTD_getErrorName(ret) << std::endl;
+        throw "Deflate Error!";
+    }
+    out.resize(ret);
+    PD("D [compress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+std::vector<char> ZFileZSTD::decompress(const char* s, size_t n){
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (nullptr == dctx){
+        std::cerr << "Error initializing the decoder: Memory allocation failed" << std::endl;
+        throw "Decoder Not initialized!";
+    }
+    std::vector<char> out;
+    size_t ret;
+    unsigned long long size = contentSize(s, n);
+    bool known = ZSTD_CONTENTSIZE_UNKNOWN != size && ZSTD_CONTENTSIZE_ERROR != size;
+    /* the frame headers can claim anything: trusted up to 1024:1, the output grows beyond */
+    if (known && size / 1024 <= n){
+        /* every frame has its size */
+        out.resize(size);
+        ret = ZSTD_decompressDCtx(dctx, out.data(), out.size(), s, n);
+        if (!ZSTD_isError(ret)){
+            out.resize(ret);
+        }
+    }else{
+        /* streamed frames, or sizes too big to be trusted, the output grows */
+        out.resize(known ? n * 1024 : 0);
+        ZSTD_inBuffer in = { s, n, 0 };
+        ZSTD_outBuffer o = { nullptr, 0, 0 };
+        bool stalled = false;
+        do {
+            if (o.pos == out.size()){
+                out.resize(out.size() < ZBUFSIZEZSTD ? ZBUFSIZEZSTD : out.size() * 2);
+            }
+            o.dst = out.data();
+            o.size = out.size();
+            size_t in_pos = in.pos;
+            size_t out_pos = o.pos;
+            ret = ZSTD_decompressStream(dctx, &o, &in);
+            stalled = in.pos == in_pos && o.pos == out_pos;
+        } while (!ZSTD_isError(ret) && !stalled && (ret || in.pos < in.size));
+        out.resize(o.pos);
+        if (!ZSTD_isError(ret) && ret){
+            /* the input ends inside a frame */
+            ZSTD_freeDCtx(dctx);
+            std::cerr << "Inflate error: truncated input" << std::endl;
+            throw "Inflate Error!";
+        }
+    }
+    ZSTD_freeDCtx(dctx);
+    if (ZSTD_isError(ret)){
+        std::cerr << "Inflate error: " << ZSTD_getErrorName(ret) << std::endl;
+        throw "Inflate Error!";
+    }
+    PD("D [decompress] in:"<<n<<" out:"<<out.size()<<std::endl);
+    return out;
+}
+
+void ZFileZSTD::open(const char* filename, std::ios_base::openmode mode){
+    ZFile::open(filename, mode);
+    if (this->mode == std::ios_base::in){
+        if (nullptr == this->dctx){
+            this->dctx = ZSTD_createDCtx();
+        }
+        size_t ret = this->dctx ? ZSTD_DCtx_reset(this->dctx, ZSTD_reset_session_and_parameters) : 0;
+        if (!ZSTD_isError(ret) && this->dctx && this->opt.window_log){
+            ret = ZSTD_DCtx_setParameter(this->dctx, ZSTD_d_windowLogMax, this->opt.window_log);
+        }
+        if (nullptr == this->dctx || ZSTD_isError(ret)){
+            std::cerr << "Error initializing the decoder: "
+                      << (this->dctx ? ZSTD_getErrorName(ret) : "Memory allocation failed") << std::endl;
+            throw "Decoder Not initialized!";
+        }
+        this->offsetbuf = 0;
+        this->end = false;
+        this->hint = 0;
+        this->pos = 0;
+        this->in.src = this->inbuf;
+        this->in.size = 0;
+        this->in.pos = 0;
+        this->out.dst = this->outbuf;
+        this->out.size = ZBUFSIZEZSTD;
+        this->out.pos = 0;
+    }
+    if (this->mode == std::ios_base::out){
+        uint32_t threads = this->opt.threads;
+        if (0 == threads){
+            threads = std::thread::hardware_concurrency();
+        }
+        /* a library built without threads has no workers to give */
+        ZSTD_bounds workers = ZSTD_cParam_getBounds(ZSTD_c_nbWorkers);
+        if (ZSTD_isError(workers.error) || threads > (uint32_t)workers.upperBound){
+            threads = ZSTD_isError(workers.error) ? 1 : workers.upperBound;
+        }
+        PD("D level:"<<this->opt.level<<" threads:"<<threads<<" window_log:"<<this->opt.window_log<<std::endl);
+
+        if (nullptr == this->cctx){
+            this->cctx = ZSTD_createCCtx();
+        }
+        size_t ret = this->cctx ? ZFileZSTD::setParameters(this->cctx, this->opt, threads) : 0;
+        if (nullptr == this->cctx || ZSTD_isError(ret)){
+            std::cerr << "Error initializing the encoder: "
+                      << (this->cctx ? ZSTD_getErrorName(ret) : "Memory allocation failed") << std::endl;
+            throw "Encoder Not initialized!";
+        }
+        this->offsetbuf = 0;
+        this->out.dst = this->outbuf;
+        this->out.size = ZBUFSIZEZSTD;
+        this->out.pos = 0;
+    }
+}
+
+void ZFileZSTD::close(){
+    if (this->mode == std::ios_base::out){
+        ZSTD_inBuffer last = { nullptr, 0, 0 };
+        size_t ret;
+        /* the workers may hold more than one outbuf of data */
+        do {
+            this->out.pos = 0;
+            ret = ZSTD_compressStream2(this->cctx, &this->out, &last, ZSTD_e_end);
+            if (ZSTD_isError(ret)){
+                std::cerr << "Deflate error: " << ZSTD_getErrorName(ret) << std::endl;
+                throw "Deflate Error!";
+            }
+            if (this->out.pos){
+                this->io->write((char*)(this->outbuf), this->out.pos);
+            }
+        } while (ret);
+        PD("D [close](out)"<<std::endl);
+    }else{
+        PD("D [close](in)"<<std::endl);
+    }
+    ZFile::close();
+}
+
+size_t ZFileZSTD::write (const char* s, size_t n){
+    if (this->mode != std::ios_base::out){
+        // Error, Not possible to read here
+        return 0;
+    }
+
+    /* ZSTD_compressStream2 reads straight from the caller's buffer */
+    ZSTD_inBuffer input = { s, n, 0 };
+
+    while (input.pos < input.size) {
+        this->out.pos = 0;
+        size_t ret = ZSTD_compressStream2(this->cctx, &this->out, &input, ZSTD_e_continue);
+        PD("D 010 ret:"<<ret<<" in.pos:"<<input.pos<<" out.pos:"<<this->out.pos<<std::endl);
+        if (ZSTD_isError(ret)){
+            std::cerr << "Deflate error: " << ZSTD_getErrorName(ret) << std::endl;
+            throw "Deflate Error!";
+        }
+        if (this->out.pos){
+            this->io->write((char*)(this->outbuf), this->out.pos);
+        }
+    }
+    return n;
+}
+
+size_t ZFileZSTD::read (char* s, size_t n){
+    if (this->mode != std::ios_base::in){
+        // Error, Not possible to write here
+        return 0;
+    }
+
+    size_t s_offset = 0;
+
+    while (true) {
+        /*
+         *  this->out.dst   = [xxxxxxxxxx------]
+         *  this->out.pos              ^
+         *  this->offsetbuf      ^
+         */
+        size_t out_size = this->out.pos - this->offsetbuf;
+        size_t copy_size = out_size > n ? n : out_size;
+
+        std::memcpy(s + s_offset, this->outbuf + this->offsetbuf, copy_size);
+
+        this->offsetbuf += copy_size;
+        s_offset += copy_size;
+        n -= copy_size;
+
+        PD("D 001 eof:"<<this->io->eof()<<" out_size:"<<out_size
+           <<" copy_size:"<<copy_size<<" s_offset:"<<s_offset<<std::endl);
+
+        if (0 == n){
+            this->pos += s_offset;
+            return s_offset;
+        }
+        if (n >= ZBUFSIZEZSTD){
+            /* the outbuf is empty, large reads are decoded straight into s */
+            bool more = this->fill((uint8_t*)s + s_offset, n);
+            size_t direct_size = this->out.pos;
+            this->out.dst = this->outbuf;
+            this->out.size = ZBUFSIZEZSTD;
+            this->out.pos = 0;
+            s_offset += direct_size;
+            n -= direct_size;
+            if (!more){
+                this->pos += s_offset;
+                return s_offset;
+            }
+        }else if (!this->fill()){
+            this->pos += s_offset;
+            return s_offset;
+        }
+    }
+}
+
+/* the outbuf is empty, decode the next chunk; false when nothing else can be decoded */
+bool ZFileZSTD::fill(){
+    return this->fill(this->outbuf, ZBUFSIZEZSTD);
+}
+
+/* decode into out, either the outbuf or the caller's buffer */
+bool ZFileZSTD::fill(uint8_t *out, size_t size){
+    this->offsetbuf = 0;
+    this->out.dst = out;
+    this->out.size = size;
+    this->out.pos = 0;
+    if (this->end){
+        return false;
+    }
+
+    if (this->in.pos == this->in.size && !this->io->eof()) {
+        const uint8_t *next;
+        // read data as a block:
+        this->in.size = this->input(this->inbuf, ZBUFSIZEZSTD, &next);
+        this->in.src = next;
+        this->in.pos = 0;
+        PD("D 004 eof:"<<this->io->eof()<<" in.size:"<<this->in.size<<std::endl);
+    }
+
+    /* frames follow each other, 0 is returned at the end of each one */
+    size_t in_pos = this->in.pos;
+    size_t ret = ZSTD_decompressStream(this->dctx, &this->out, &this->in);
+    PD("D 010 eof:"<<this->io->eof()<<" ret:"<<ret<<" in.pos:"<<this->in.pos<<" out.pos:"<<this->out.pos<<std::endl);
+    if (ZSTD_isError(ret)){
+        std::cerr << "Inflate error: " << ZSTD_getErrorName(ret) << std::endl;
+        throw "Inflate Error!";
+    }
+    if (this->in.pos != in_pos || this->out.pos){
+        this->hint = ret;
+    }
+    if (0 == this->out.pos && this->in.pos == this->in.size && this->io->eof()){
+        /* end of the file, the last frame has to be complete */
+        if (this->hint){
+            std::cerr << "Inflate error: truncated input" << std::endl;
+            throw "Inflate Error!";
+        }
+        this->end = true;
+        return false;
+    }
+    return true;
+}
+
+size_t ZFileZSTD::peek(const char** s){
+    size_t out_size = 0;
+    if (this->mode == std::ios_base::in){
+        while (0 == (out_size = this->out.pos - this->offsetbuf) && this->fill());
+    }
+    *s = (const char*)(this->outbuf + this->offsetbuf);
+    return out_size;
+}
+
+void ZFileZSTD::consume(size_t n){
+    size_t out_size = this->out.pos - this->offsetbuf;
+    n = n > out_size ? out_size : n;
+    this->offsetbuf += n;
+    this->pos += n;
+}
+
+uint64_t ZFileZSTD::tell() const{
+    return this->pos;
+}
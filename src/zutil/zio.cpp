@@ -0,0 +1,57 @@
+/* zio.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <zutil/zio.h>
+
+bool ZIOStream::open(const char* filename, std::ios_base::openmode mode){
+    this->fs.open(filename, mode | std::ios_base::binary);
+    return this->fs.is_open();
+}
+
+void ZIOStream::close(){
+    this->fs.close();
+}
+
+size_t ZIOStream::read (char* s, size_t n){
+    this->fs.read(s, n);
+    return this->fs.gcount();
+}
+
+size_t ZIOStream::write (const char* s, size_t n){
+    this->fs.write(s, n);
+    return this->fs ? n : 0;
+}
+
+bool ZIOStream::seek(uint64_t offset){
+    this->fs.clear();
+    this->fs.seekg(offset);
+    return !this->fs.fail();
+}
+
+bool ZIOStream::eof() const{
+    return this->fs.eof();
+}
@@ -0,0 +1,283 @@
+/* ziofd.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <cstring>
+
+#include <zutil/ziofd.h>
+
+/* O_DIRECT needs aligned buffers, offsets and sizes */
+#define ZIO_ALIGN    (4096)
+/* the page cache is dropped in steps of this size */
+#define ZIO_DROPSIZE (8 * 1024 * 1024)
+
+// #define DEBUG
+
+#ifdef DEBUG
+#define PD(_d) do { std::cout << " #(fd) " << _d ;}while(0)
+#else
+#define PD(_d) do {;}while(0)
+#endif
+
+static size_t _pread_all(int fd, uint8_t *buf, size_t n, uint64_t offset){
+    size_t done = 0;
+    while (done < n){
+        ssize_t ret = pread(fd, buf + done, n - done, offset + done);
+        if (ret < 0 && EINTR == errno){
+            continue;
+        }
+        if (ret <= 0){
+            break;
+        }
+        done += ret;
+    }
+    return done;
+}
+
+static size_t _pwrite_all(int fd, const uint8_t *buf, size_t n, uint64_t offset){
+    size_t done = 0;
+    while (done < n){
+        ssize_t ret = pwrite(fd, buf + done, n - done, offset + done);
+        if (ret < 0 && EINTR == errno){
+            continue;
+        }
+        if (ret <= 0){
+            break;
+        }
+        done += ret;
+    }
+    return done;
+}
+
+ZIOFd::ZIOFd(const ZIOFd::options &opt)
+    : opt(opt), fd(-1), buf(nullptr)
+{
+    this->opt.bufsize = (this->opt.bufsize + ZIO_ALIGN - 1) & ~(size_t)(ZIO_ALIGN - 1);
+    if (this->opt.bufsize == 0){
+        this->opt.bufsize = ZIO_ALIGN;
+    }
+}
+
+ZIOFd::ZIOFd()
+    : fd(-1), buf(nullptr)
+{
+}
+
+ZIOFd::~ZIOFd(){
+    this->close();
+}
+
+bool ZIOFd::open(const char* filename, std::ios_base::openmode mode){
+    this->close();
+    this->mode = mode;
+    int flags = (mode == std::ios_base::in) ? O_RDONLY : (O_WRONLY | O_CREAT | O_TRUNC);
+#ifdef O_DIRECT
+    if (this->opt.direct){
+        this->fd = ::open(filename, flags | O_DIRECT, 0644);
+        if (this->fd < 0 && EINVAL == errno){
+            /* not supported by this file system, go on with the page cache */
+            PD("D [open] O_DIRECT not supported"<<std::endl);
+            this->opt.direct = false;
+        }
+    }
+#else
+    this->opt.direct = false;
+#endif
+    if (this->fd < 0){
+        this->fd = ::open(filename, flags, 0644);
+    }
+    if (this->fd < 0){
+        return false;
+    }
+    if (posix_memalign((void**)&this->buf, ZIO_ALIGN, this->opt.bufsize)){
+        ::close(this->fd);
+        this->fd = -1;
+        this->buf = nullptr;
+        return false;
+    }
+    if (this->opt.sequential && !this->opt.direct){
+        (void)posix_fadvise(this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    this->bufbase = 0;
+    this->buflen = 0;
+    this->pos = 0;
+    this->dropped = 0;
+    this->started = 0;
+    this->eofflag = false;
+    return true;
+}
+
+void ZIOFd::close(){
+    if (this->fd >= 0){
+        if (this->mode == std::ios_base::out && this->buflen){
+#ifdef O_DIRECT
+            if (this->opt.direct && (this->buflen % ZIO_ALIGN)){
+                /* the tail is not aligned, write it through the page cache */
+                int flags = fcntl(this->fd, F_GETFL);
+                (void)fcntl(this->fd, F_SETFL, flags & ~O_DIRECT);
+            }
+#endif
+            this->flush();
+        }
+        if (this->opt.dontneed && !this->opt.direct){
+            if (this->mode == std::ios_base::out){
+                (void)fdatasync(this->fd);
+            }
+            (void)posix_fadvise(this->fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
+        ::close(this->fd);
+        this->fd = -1;
+    }
+    if (this->buf){
+        free(this->buf);
+        this->buf = nullptr;
+    }
+}
+
+/* release the page cache behind the current position */
+void ZIOFd::advise(){
+    if (!this->opt.dontneed || this->opt.direct || this->pos < this->dropped + ZIO_DROPSIZE){
+        return;
+    }
+    uint64_t end = this->pos & ~(uint64_t)(ZIO_ALIGN - 1);
+    if (this->mode == std::ios_base::out){
+#ifdef SYNC_FILE_RANGE_WRITE
+        /* start the writeback of the new data, wait for the previous one and drop it,
+         * a 0 length would mean up to the end of the file */
+        if (end > this->started){
+            (void)sync_file_range(this->fd, this->started, end - this->started, SYNC_FILE_RANGE_WRITE);
+        }
+        if (this->started > this->dropped){
+            (void)sync_file_range(this->fd, this->dropped, this->started - this->dropped,
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        }
+        end = this->started;
+        this->started = this->pos & ~(uint64_t)(ZIO_ALIGN - 1);
+#else
+        (void)fdatasync(this->fd);
+#endif
+    }
+    if (end > this->dropped){
+        PD("D [advise] dontneed:"<<this->dropped<<"-"<<end<<std::endl);
+        (void)posix_fadvise(this->fd, this->dropped, end - this->dropped, POSIX_FADV_DONTNEED);
+        this->dropped = end;
+    }
+}
+
+size_t ZIOFd::read (char* s, size_t n){
+    if (this->fd < 0 || this->mode != std::ios_base::in){
+        return 0;
+    }
+    size_t s_offset = 0;
+    while (s_offset < n){
+        if (this->pos >= this->bufbase && this->pos < this->bufbase + this->buflen){
+            size_t offset = this->pos - this->bufbase;
+            size_t copy_size = this->buflen - offset;
+            copy_size = copy_size > n - s_offset ? n - s_offset : copy_size;
+            std::memcpy(s + s_offset, this->buf + offset, copy_size);
+            s_offset += copy_size;
+            this->pos += copy_size;
+            continue;
+        }
+        if (!this->opt.direct && n - s_offset >= this->opt.bufsize){
+            /* large reads go straight to the caller */
+            size_t size = _pread_all(this->fd, (uint8_t*)s + s_offset, n - s_offset, this->pos);
+            s_offset += size;
+            this->pos += size;
+            if (s_offset < n){
+                this->eofflag = true;
+            }
+            break;
+        }
+        this->bufbase = this->opt.direct ? (this->pos & ~(uint64_t)(ZIO_ALIGN - 1)) : this->pos;
+        this->buflen = _pread_all(this->fd, this->buf, this->opt.bufsize, this->bufbase);
+        PD("D [read] pread:"<<this->bufbase<<" size:"<<this->buflen<<std::endl);
+        if (this->pos >= this->bufbase + this->buflen){
+            this->eofflag = true;
+            break;
+        }
+    }
+    this->advise();
+    return s_offset;
+}
+
+bool ZIOFd::flush(){
+    size_t size = _pwrite_all(this->fd, this->buf, this->buflen, this->pos);
+    PD("D [flush] pwrite:"<<this->pos<<" size:"<<size<<std::endl);
+    this->pos += size;
+    bool ret = (size == this->buflen);
+    this->buflen = 0;
+    return ret;
+}
+
+size_t ZIOFd::write (const char* s, size_t n){
+    if (this->fd < 0 || this->mode != std::ios_base::out){
+        return 0;
+    }
+    size_t s_offset = 0;
+    while (s_offset < n){
+        if (!this->opt.direct && 0 == this->buflen && n - s_offset >= this->opt.bufsize){
+            /* large writes go straight from the caller */
+            size_t size = _pwrite_all(this->fd, (const uint8_t*)s + s_offset, n - s_offset, this->pos);
+            this->pos += size;
+            s_offset += size;
+            if (s_offset < n){
+                return s_offset;
+            }
+            break;
+        }
+        size_t copy_size = this->opt.bufsize - this->buflen;
+        copy_size = copy_size > n - s_offset ? n - s_offset : copy_size;
+        std::memcpy(this->buf + this->buflen, s + s_offset, copy_size);
+        this->buflen += copy_size;
+        s_offset += copy_size;
+        if (this->buflen == this->opt.bufsize && !this->flush()){
+            std::cerr << "Error writing the file: " << strerror(errno) << "\n";
+            return 0;
+        }
+    }
+    this->advise();
+    return s_offset;
+}
+
+bool ZIOFd::seek(uint64_t offset){
+    if (this->fd < 0 || this->mode != std::ios_base::in){
+        return false;
+    }
+    this->pos = offset;
+    this->eofflag = false;
+    return true;
+}
+
+bool ZIOFd::eof() const{
+    return this->eofflag;
+}
@@ -0,0 +1,192 @@
+/* ziommap.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <iostream>
+#include <cstring>
+
+#include <zutil/ziommap.h>
+
+// #define DEBUG
+
+#ifdef DEBUG
+#define PD(_d) do { std::cout << " #(mmap) " << _d ;}while(0)
+#else
+#define PD(_d) do {;}while(0)
+#endif
+
+ZIOMmap::ZIOMmap(const ZIOMmap::options &opt)
+    : opt(opt), fd(-1), base(nullptr)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    this->opt.window = (this->opt.window + page - 1) & ~(page - 1);
+    if (this->opt.window == 0){
+        this->opt.window = page;
+    }
+}
+
+ZIOMmap::ZIOMmap()
+    : fd(-1), base(nullptr)
+{
+}
+
+ZIOMmap::~ZIOMmap(){
+    this->close();
+}
+
+bool ZIOMmap::open(const char* filename, std::ios_base::openmode mode){
+    this->close();
+    if (mode != std::ios_base::in){
+        std::cerr << "ERROR: ZIOMmap supports only ios_base::in\n";
+        return false;
+    }
+    struct stat st;
+    this->fd = ::open(filename, O_RDONLY);
+    if (this->fd < 0 || fstat(this->fd, &st)){
+        this->close();
+        return false;
+    }
+    this->size = st.st_size;
+    this->mapoff = 0;
+    this->maplen = 0;
+    this->pos = 0;
+    this->advised = 0;
+    this->released = 0;
+    this->eofflag = false;
+    return true;
+}
+
+void ZIOMmap::close(){
+    if (this->base){
+        munmap(this->base, this->maplen);
+        this->base = nullptr;
+    }
+    if (this->fd >= 0){
+        ::close(this->fd);
+        this->fd = -1;
+    }
+}
+
+/* map the window holding offset */
+bool ZIOMmap::remap(uint64_t offset){
+    if (this->base){
+        munmap(this->base, this->maplen);
+        this->base = nullptr;
+    }
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    this->mapoff = offset & ~(page - 1);
+    this->maplen = this->size - this->mapoff < this->opt.window ? this->size - this->mapoff : this->opt.window;
+    void *p = mmap(nullptr, this->maplen, PROT_READ, MAP_SHARED, this->fd, this->mapoff);
+    if (MAP_FAILED == p){
+        std::cerr << "Error mapping the file: " << strerror(errno) << "\n";
+        this->maplen = 0;
+        return false;
+    }
+    PD("D [remap] offset:"<<this->mapoff<<" size:"<<this->maplen<<std::endl);
+    this->base = (uint8_t*)p;
+    (void)madvise(this->base, this->maplen, MADV_SEQUENTIAL);
+    this->advised = this->mapoff;
+    this->released = this->mapoff;
+    return true;
+}
+
+/* keep the kernel reading ahead of us, drop what is behind done (the chunk still in use starts there) */
+void ZIOMmap::advise(uint64_t done){
+    uint64_t end = this->mapoff + this->maplen;
+    if (this->opt.readahead && this->advised < end && this->pos + this->opt.readahead > this->advised){
+        uint64_t to = this->pos + 2 * this->opt.readahead;
+        to = to > end ? end : to;
+        (void)madvise(this->base + (this->advised - this->mapoff), to - this->advised, MADV_WILLNEED);
+        this->advised = to;
+    }
+    if (this->opt.release){
+        uint64_t page = sysconf(_SC_PAGESIZE);
+        uint64_t to = done & ~(page - 1);
+        if (to > this->released){
+            (void)madvise(this->base + (this->released - this->mapoff), to - this->released, MADV_DONTNEED);
+            this->released = to;
+        }
+    }
+}
+
+size_t ZIOMmap::map(const char** s, size_t n){
+    if (this->fd < 0 || this->pos >= this->size){
+        this->eofflag = true;
+        return 0;
+    }
+    if (this->pos < this->mapoff || this->pos >= this->mapoff + this->maplen || nullptr == this->base){
+        if (!this->remap(this->pos)){
+            this->eofflag = true;
+            return 0;
+        }
+    }
+    size_t avail = this->mapoff + this->maplen - this->pos;
+    size_t size = n > avail ? avail : n;
+    *s = (const char*)(this->base + (this->pos - this->mapoff));
+    uint64_t start = this->pos;
+    this->pos += size;
+    if (size < n && this->pos == this->size){
+        this->eofflag = true;
+    }
+    this->advise(start);
+    return size;
+}
+
+size_t ZIOMmap::read (char* s, size_t n){
+    size_t s_offset = 0;
+    const char *p;
+    size_t size;
+    while (s_offset < n && (size = this->map(&p, n - s_offset))){
+        std::memcpy(s + s_offset, p, size);
+        s_offset += size;
+    }
+    return s_offset;
+}
+
+size_t ZIOMmap::write (const char* s, size_t n){
+    (void)s;
+    (void)n;
+    return 0;
+}
+
+bool ZIOMmap::seek(uint64_t offset){
+    if (this->fd < 0){
+        return false;
+    }
+    this->pos = offset;
+    this->eofflag = false;
+    return true;
+}
+
+bool ZIOMmap::eof() const{
+    return this->eofflag;
+}
@@ -0,0 +1,197 @@
+/* zioreadahead.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <cstring>
+
+#include <zutil/zioreadahead.h>
+
+// #define DEBUG
+
+#ifdef DEBUG
+#define PD(_d) do { std::cout << " #(readahead) " << _d ;}while(0)
+#else
+#define PD(_d) do {;}while(0)
+#endif
+
+ZIOReadAhead::ZIOReadAhead(const ZIOReadAhead::options &opt, ZIO *io)
+    : opt(opt), io(io ? io : new ZIOStream()), mode(std::ios_base::app)
+{
+    if (this->opt.depth == 0){
+        this->opt.depth = 1;
+    }
+    if (this->opt.bufsize == 0){
+        this->opt.bufsize = 4096;
+    }
+}
+
+ZIOReadAhead::ZIOReadAhead()
+    : io(new ZIOStream()), mode(std::ios_base::app)
+{
+}
+
+ZIOReadAhead::~ZIOReadAhead(){
+    this->close();
+    delete this->io;
+}
+
+bool ZIOReadAhead::open(const char* filename, std::ios_base::openmode mode){
+    this->close();
+    this->mode = mode;
+    if (!this->io->open(filename, mode)){
+        return false;
+    }
+    if (mode == std::ios_base::in){
+        this->slots.resize(this->opt.depth);
+        for (slot &s : this->slots){
+            s.buf.resize(this->opt.bufsize);
+        }
+        this->start();
+    }
+    return true;
+}
+
+void ZIOReadAhead::close(){
+    this->stop();
+    this->slots.clear();
+    this->io->close();
+}
+
+void ZIOReadAhead::start(){
+    this->filled = 0;
+    this->taken = 0;
+    this->quit = false;
+    this->headoff = 0;
+    this->eofflag = false;
+    this->thread = std::thread(&ZIOReadAhead::reader, this);
+}
+
+void ZIOReadAhead::stop(){
+    if (this->thread.joinable()){
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->quit = true;
+        }
+        this->room.notify_one();
+        this->thread.join();
+    }
+}
+
+/* the I/O thread, the producer side of the ring */
+void ZIOReadAhead::reader(){
+    uint64_t filled = this->filled.load(std::memory_order_relaxed);
+    while (true){
+        if (filled - this->taken.load(std::memory_order_acquire) == this->opt.depth){
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->room.wait(guard, [&]{
+                return this->quit || filled - this->taken.load(std::memory_order_acquire) < this->opt.depth; });
+        }
+        if (this->quit){
+            return;
+        }
+        slot &s = this->slots[filled % this->opt.depth];
+        s.len = this->io->read((char*)s.buf.data(), this->opt.bufsize);
+        s.last = s.len < this->opt.bufsize || this->io->eof();
+        PD("D [reader] slot:"<<filled<<" len:"<<s.len<<std::endl);
+        this->filled.store(++filled, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+        }
+        this->ready.notify_one();
+        if (s.last){
+            return;
+        }
+    }
+}
+
+bool ZIOReadAhead::mappable() const{
+    return this->mode == std::ios_base::in;
+}
+
+size_t ZIOReadAhead::map(const char** s, size_t n){
+    if (this->mode != std::ios_base::in || this->slots.empty()){
+        return 0;
+    }
+    while (!this->eofflag){
+        uint64_t taken = this->taken.load(std::memory_order_relaxed);
+        if (taken == this->filled.load(std::memory_order_acquire)){
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->ready.wait(guard, [&]{ return taken != this->filled.load(std::memory_order_acquire); });
+        }
+        slot &h = this->slots[taken % this->opt.depth];
+        size_t avail = h.len - this->headoff;
+        if (avail){
+            size_t size = n > avail ? avail : n;
+            *s = (const char*)(h.buf.data() + this->headoff);
+            this->headoff += size;
+            return size;
+        }
+        if (h.last){
+            this->eofflag = true;
+            break;
+        }
+        /* the head slot is used up, give it back to the reader */
+        this->headoff = 0;
+        this->taken.store(taken + 1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+        }
+        this->room.notify_one();
+    }
+    return 0;
+}
+
+size_t ZIOReadAhead::read (char* s, size_t n){
+    size_t s_offset = 0;
+    const char *p;
+    size_t size;
+    while (s_offset < n && (size = this->map(&p, n - s_offset))){
+        std::memcpy(s + s_offset, p, size);
+        s_offset += size;
+    }
+    return s_offset;
+}
+
+size_t ZIOReadAhead::write (const char* s, size_t n){
+    return this->io->write(s, n);
+}
+
+bool ZIOReadAhead::seek(uint64_t offset){
+    if (this->mode != std::ios_base::in){
+        return false;
+    }
+    this->stop();
+    bool ret = this->io->seek(offset);
+    this->start();
+    return ret;
+}
+
+bool ZIOReadAhead::eof() const{
+    if (this->mode != std::ios_base::in){
+        return this->io->eof();
+    }
+    return this->eofflag;
+}
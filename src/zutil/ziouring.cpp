@@ -0,0 +1,397 @@
+/* ziouring.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <cstring>
+
+#include <zutil/ziouring.h>
+#include <zutil/ziofd.h>
+
+// #define DEBUG
+
+#ifdef DEBUG
+#define PD(_d) do { std::cout << " #(uring) " << _d ;}while(0)
+#else
+#define PD(_d) do {;}while(0)
+#endif
+
+/* the raw ring, liburing is not required */
+struct ZIOUring::uring{
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+    std::vector<struct iovec> iov;
+};
+
+static int _uring_setup(unsigned entries, struct io_uring_params *p){
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int _uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags){
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+ZIOUring::ZIOUring(const ZIOUring::options &opt)
+    : opt(opt), ring(nullptr), fallback(nullptr), fd(-1)
+{
+    if (this->opt.depth == 0){
+        this->opt.depth = 1;
+    }
+    if (this->opt.bufsize == 0){
+        this->opt.bufsize = 4096;
+    }
+}
+
+ZIOUring::ZIOUring()
+    : ring(nullptr), fallback(nullptr), fd(-1)
+{
+}
+
+ZIOUring::~ZIOUring(){
+    this->close();
+}
+
+bool ZIOUring::setup(){
+    struct io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    int rfd = _uring_setup(this->opt.depth, &p);
+    if (rfd < 0){
+        PD("D [setup] io_uring not available: "<<strerror(errno)<<std::endl);
+        return false;
+    }
+    uring *r = new uring();
+    r->fd = rfd;
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP){
+        r->sq_size = r->cq_size = r->sq_size > r->cq_size ? r->sq_size : r->cq_size;
+    }
+    r->sq_ptr = mmap(nullptr, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_SQ_RING);
+    r->cq_ptr = MAP_FAILED;
+    r->sqes = (struct io_uring_sqe*)MAP_FAILED;
+    if (MAP_FAILED != r->sq_ptr){
+        r->cq_ptr = (p.features & IORING_FEAT_SINGLE_MMAP) ? r->sq_ptr :
+            mmap(nullptr, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_CQ_RING);
+        r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        r->sqes = (struct io_uring_sqe*)mmap(nullptr, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_SQES);
+    }
+    if (MAP_FAILED == r->sq_ptr || MAP_FAILED == r->cq_ptr || MAP_FAILED == (void*)r->sqes){
+        this->ring = r;
+        this->teardown();
+        return false;
+    }
+    r->sq_head  = (unsigned*)((char*)r->sq_ptr + p.sq_off.head);
+    r->sq_tail  = (unsigned*)((char*)r->sq_ptr + p.sq_off.tail);
+    r->sq_mask  = (unsigned*)((char*)r->sq_ptr + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)((char*)r->sq_ptr + p.sq_off.array);
+    r->cq_head  = (unsigned*)((char*)r->cq_ptr + p.cq_off.head);
+    r->cq_tail  = (unsigned*)((char*)r->cq_ptr + p.cq_off.tail);
+    r->cq_mask  = (unsigned*)((char*)r->cq_ptr + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe*)((char*)r->cq_ptr + p.cq_off.cqes);
+    r->iov.resize(this->opt.depth);
+    this->ring = r;
+    return true;
+}
+
+void ZIOUring::teardown(){
+    uring *r = this->ring;
+    if (nullptr == r){
+        return;
+    }
+    if (MAP_FAILED != (void*)r->sqes){
+        munmap(r->sqes, r->sqes_size);
+    }
+    if (MAP_FAILED != r->cq_ptr && r->cq_ptr != r->sq_ptr){
+        munmap(r->cq_ptr, r->cq_size);
+    }
+    if (MAP_FAILED != r->sq_ptr){
+        munmap(r->sq_ptr, r->sq_size);
+    }
+    ::close(r->fd);
+    delete r;
+    this->ring = nullptr;
+}
+
+bool ZIOUring::open(const char* filename, std::ios_base::openmode mode){
+    this->close();
+    this->mode = mode;
+    if (!this->setup()){
+        ZIOFd::options fopt;
+        fopt.bufsize = this->opt.bufsize;
+        this->fallback = new ZIOFd(fopt);
+        return this->fallback->open(filename, mode);
+    }
+    int flags = (mode == std::ios_base::in) ? O_RDONLY : (O_WRONLY | O_CREAT | O_TRUNC);
+    this->fd = ::open(filename, flags, 0644);
+    if (this->fd < 0){
+        this->teardown();
+        return false;
+    }
+    if (mode == std::ios_base::in){
+        (void)posix_fadvise(this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    this->slots.resize(this->opt.depth);
+    for (slot &s : this->slots){
+        s.buf = new uint8_t[this->opt.bufsize];
+        s.busy = false;
+        s.len = 0;
+        s.res = 0;
+    }
+    this->eofflag = false;
+    if (mode == std::ios_base::in){
+        this->start(0);
+    }else{
+        this->head = 0;
+        this->headoff = 0;
+        this->next = 0;
+    }
+    return true;
+}
+
+void ZIOUring::close(){
+    if (this->fallback){
+        this->fallback->close();
+        delete this->fallback;
+        this->fallback = nullptr;
+    }
+    if (this->fd >= 0){
+        if (this->mode == std::ios_base::out && this->headoff){
+            this->submit(this->head, this->next, this->headoff);
+            this->next += this->headoff;
+            this->headoff = 0;
+        }
+        if (!this->drain() && this->mode == std::ios_base::out){
+            std::cerr << "Error writing the file: a queued write did not complete\n";
+        }
+        ::close(this->fd);
+        this->fd = -1;
+    }
+    for (slot &s : this->slots){
+        delete[] s.buf;
+    }
+    this->slots.clear();
+    this->teardown();
+}
+
+/* queue a read or a write of slot i */
+void ZIOUring::submit(unsigned i, uint64_t offset, size_t len){
+    uring *r = this->ring;
+    slot &s = this->slots[i];
+    s.offset = offset;
+    s.len = len;
+    s.res = 0;
+    s.busy = true;
+    r->iov[i].iov_base = s.buf;
+    r->iov[i].iov_len = len;
+
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (this->mode == std::ios_base::in) ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = this->fd;
+    sqe->off = offset;
+    sqe->addr = (unsigned long)&r->iov[i];
+    sqe->len = 1;
+    sqe->user_data = i;
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    int ret;
+    while ((ret = _uring_enter(r->fd, 1, 0, 0)) < 0 && EINTR == errno);
+    if (ret < 0){
+        std::cerr << "io_uring submit error: " << strerror(errno) << "\n";
+        s.res = -errno;
+        s.busy = false;
+    }
+    PD("D [submit] slot:"<<i<<" offset:"<<offset<<" len:"<<len<<std::endl);
+}
+
+/* wait for slot i, short transfers are finished synchronously; false on error */
+bool ZIOUring::complete(unsigned i){
+    uring *r = this->ring;
+    while (this->slots[i].busy){
+        unsigned head = *r->cq_head;
+        if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)){
+            if (_uring_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && EINTR != errno){
+                std::cerr << "io_uring wait error: " << strerror(errno) << "\n";
+                return false;
+            }
+            continue;
+        }
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        slot &s = this->slots[cqe->user_data];
+        s.res = cqe->res;
+        s.busy = false;
+        __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    }
+    slot &s = this->slots[i];
+    while (s.res > 0 && (size_t)s.res < s.len){
+        ssize_t ret = (this->mode == std::ios_base::in) ?
+            pread(this->fd, s.buf + s.res, s.len - s.res, s.offset + s.res) :
+            pwrite(this->fd, s.buf + s.res, s.len - s.res, s.offset + s.res);
+        if (ret < 0 && EINTR == errno){
+            continue;
+        }
+        if (ret <= 0){
+            break;
+        }
+        s.res += ret;
+    }
+    if (s.res < 0){
+        std::cerr << "io_uring I/O error: " << strerror(-s.res) << "\n";
+        return false;
+    }
+    return this->mode == std::ios_base::in || (size_t)s.res == s.len;
+}
+
+/* read ahead from offset with all the slots */
+void ZIOUring::start(uint64_t offset){
+    for (unsigned i = 0; i < this->opt.depth; i++){
+        this->submit(i, offset + i * this->opt.bufsize, this->opt.bufsize);
+    }
+    this->head = 0;
+    this->headoff = 0;
+    this->next = offset + this->opt.depth * this->opt.bufsize;
+}
+
+/* wait for every slot; false if any of them failed */
+bool ZIOUring::drain(){
+    bool ok = true;
+    for (unsigned i = 0; i < this->slots.size(); i++){
+        ok = this->complete(i) && ok;
+    }
+    return ok;
+}
+
+bool ZIOUring::mappable() const{
+    return nullptr == this->fallback && this->mode == std::ios_base::in;
+}
+
+size_t ZIOUring::map(const char** s, size_t n){
+    if (this->fd < 0 || this->mode != std::ios_base::in){
+        return 0;
+    }
+    while (true){
+        slot &h = this->slots[this->head];
+        if (!this->complete(this->head)){
+            this->eofflag = true;
+            return 0;
+        }
+        size_t avail = h.res - this->headoff;
+        if (avail){
+            size_t size = n > avail ? avail : n;
+            *s = (const char*)(h.buf + this->headoff);
+            this->headoff += size;
+            return size;
+        }
+        if ((size_t)h.res < h.len){
+            this->eofflag = true;
+            return 0;
+        }
+        /* the head slot is used up, recycle it for the next chunk */
+        this->submit(this->head, this->next, this->opt.bufsize);
+        this->next += this->opt.bufsize;
+        this->head = (this->head + 1) % this->opt.depth;
+        this->headoff = 0;
+    }
+}
+
+size_t ZIOUring::read (char* s, size_t n){
+    if (this->fallback){
+        return this->fallback->read(s, n);
+    }
+    size_t s_offset = 0;
+    const char *p;
+    size_t size;
+    while (s_offset < n && (size = this->map(&p, n - s_offset))){
+        std::memcpy(s + s_offset, p, size);
+        s_offset += size;
+    }
+    return s_offset;
+}
+
+size_t ZIOUring::write (const char* s, size_t n){
+    if (this->fallback){
+        return this->fallback->write(s, n);
+    }
+    if (this->fd < 0 || this->mode != std::ios_base::out){
+        return 0;
+    }
+    size_t s_offset = 0;
+    while (s_offset < n){
+        if (0 == this->headoff && !this->complete(this->head)){
+            return 0;
+        }
+        slot &h = this->slots[this->head];
+        size_t copy_size = this->opt.bufsize - this->headoff;
+        copy_size = copy_size > n - s_offset ? n - s_offset : copy_size;
+        std::memcpy(h.buf + this->headoff, s + s_offset, copy_size);
+        this->headoff += copy_size;
+        s_offset += copy_size;
+        if (this->headoff == this->opt.bufsize){
+            this->submit(this->head, this->next, this->headoff);
+            this->next += this->headoff;
+            this->head = (this->head + 1) % this->opt.depth;
+            this->headoff = 0;
+        }
+    }
+    return n;
+}
+
+bool ZIOUring::seek(uint64_t offset){
+    if (this->fallback){
+        return this->fallback->seek(offset);
+    }
+    if (this->fd < 0 || this->mode != std::ios_base::in){
+        return false;
+    }
+    (void)this->drain();
+    this->start(offset);
+    this->eofflag = false;
+    return true;
+}
+
+bool ZIOUring::eof() const{
+    if (this->fallback){
+        return this->fallback->eof();
+    }
+    return this->eofflag;
+}
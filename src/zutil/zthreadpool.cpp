@@ -0,0 +1,78 @@
+/* zthreadpool.cpp -- "zutil"
+
+   This file is part of the zutil library.
+
+   Copyright (C) 2019 Eugenio Parodi
+   All Rights Reserved.
+
+   the zutil library is free software; you can redistribute them
+   and/or modify them under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 3 of
+   the License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; see the file COPYING.
+   If not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+
+   Eugenio Parodi
+   <ceccopierangiolieugenio@googlemail.com>
+   https://github.com/ceccopierangiolieugenio/libzutil
+ */
+
+#include <zutil/zthreadpool.h>
+
+ZThreadPool::ZThreadPool(unsigned int threads)
+    : quit(false)
+{
+    for (unsigned int i = 0; i < threads; i++){
+        this->threads.emplace_back(&ZThreadPool::worker, this);
+    }
+}
+
+ZThreadPool::~ZThreadPool(){
+    {
+        std::unique_lock<std::mutex> lk(this->lock);
+        this->quit = true;
+    }
+    this->work.notify_all();
+    for (auto &t : this->threads){
+        t.join();
+    }
+}
+
+std::future<void> ZThreadPool::submit(std::function<void()> job){
+    std::packaged_task<void()> task(job);
+    std::future<void> ret = task.get_future();
+    {
+        std::unique_lock<std::mutex> lk(this->lock);
+        this->jobs.push_back(std::move(task));
+    }
+    this->work.notify_one();
+    return ret;
+}
+
+unsigned int ZThreadPool::size() const{
+    return this->threads.size();
+}
+
+void ZThreadPool::worker(){
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lk(this->lock);
+            this->work.wait(lk, [this]{ return this->quit || !this->jobs.empty(); });
+            if (this->quit){
+                return;
+            }
+            task = std::move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+        task();
+    }
+}
@@ -32,6 +32,14 @@
 #include <zutil/zfilexz.h>
 #include <zutil/zfilegz.h>
 #include <zutil/zfilelzo.h>
+#include <zutil/zfilezstd.h>
+#include <zutil/zfilelz4.h>
+#include <zutil/zfilebz2.h>
+#include <zutil/zfileasync.h>
+#include <zutil/ziofd.h>
+#include <zutil/ziommap.h>
+#include <zutil/ziouring.h>
+#include <zutil/zioreadahead.h>
 
 
 using namespace std;
@@ -83,6 +91,47 @@ int test_inflate_001(ZFile *zf, const char * filename)
 	delete[] buf;
 }
 
+void test_inflate_002(ZFile *zf, const char * infilename, const char * outfilename)
+{
+	/* test inflate with large reads, decoded straight into buf */
+	zf->open(infilename, std::ios_base::in);
+	std::ofstream outfile (outfilename, std::ofstream::binary);
+
+	const int bufsize = ( 4 * 1024 * 1024 ); /* 4M */
+	char * buf = new char[bufsize];
+	size_t size;
+
+	while ((size = zf->read(buf, bufsize))){
+		outfile.write(buf, size);
+	}
+
+	zf->close();
+	outfile.close();
+	delete[] buf;
+}
+
+void test_peek_001(ZFile *zf, const char * filename)
+{
+	/* test inflate, working on the decoder buffer */
+	zf->open(filename, std::ios_base::in);
+
+	const char * buf;
+	size_t size;
+	size_t total = 0;
+	size_t lines = 0;
+
+	while ((size = zf->peek(&buf))){
+		for (size_t i = 0; i < size; i++){
+			if ('\n' == buf[i]) lines++;
+		}
+		total += size;
+		zf->consume(size);
+	}
+	std::cout << "total: " << total << " lines: " << lines << std::endl ;
+
+	zf->close();
+}
+
 int test_deflate_001(ZFile *zf, const char * infilename, const char * outfilename)
 {
 	/* Test XZ deflate */
@@ -112,6 +161,225 @@ int test_deflate_001(ZFile *zf, const char * infilename, const char * outfilenam
 	delete[] buf;
 }
 
+void test_seek_001_gz(const char * filename)
+{
+	/* read the second half after a seek, using the saved index when present */
+	ZFileGZ zgz;
+	std::string idxname = std::string(filename) + ".idx";
+	zgz.open(filename, std::ios_base::in);
+	if (!zgz.loadIndex(idxname.c_str())){
+		zgz.buildIndex();
+		zgz.saveIndex(idxname.c_str());
+	}
+
+	std::ifstream infile ("test.big.txt",std::ifstream::binary | std::ifstream::ate);
+	uint64_t half = (uint64_t)infile.tellg() / 2;
+	zgz.seek(half);
+
+	const int bufsize = ( 1024 * 1024 ); /* 1M */
+	char * buf = new char[bufsize];
+	size_t size;
+	size_t total = 0;
+	while ((size = zgz.read(buf, bufsize))){
+		total += size;
+	}
+	std::cout << "seek: " << half << " total: " << total << " tell: " << zgz.tell() << std::endl ;
+
+	zgz.close();
+	delete[] buf;
+}
+
+void test_seek_001_xz(const char * filename)
+{
+	/* read the second half after a seek */
+	ZFileXZ zxz;
+	zxz.open(filename, std::ios_base::in);
+
+	std::ifstream infile ("test.big.txt",std::ifstream::binary | std::ifstream::ate);
+	uint64_t half = (uint64_t)infile.tellg() / 2;
+	zxz.seek(half);
+
+	const int bufsize = ( 1024 * 1024 ); /* 1M */
+	char * buf = new char[bufsize];
+	size_t size;
+	size_t total = 0;
+	while ((size = zxz.read(buf, bufsize))){
+		total += size;
+	}
+	std::cout << "seek: " << half << " total: " << total << " tell: " << zxz.tell() << std::endl ;
+
+	zxz.close();
+	delete[] buf;
+}
+
+void test_seek_002_xz(const char * filename, uint64_t block_size)
+{
+	/* seek across the blocks, back and forth, and check what is read */
+	std::ifstream infile ("test.big.txt",std::ifstream::binary | std::ifstream::ate);
+	uint64_t length = infile.tellg();
+	std::vector<char> in(length);
+	infile.seekg(0);
+	infile.read(in.data(), length);
+
+	std::vector<uint64_t> offsets;
+	offsets.push_back(length - 1);
+	offsets.push_back(0);
+	for (uint64_t b = 5 * block_size; b < length; b += 4 * block_size){
+		offsets.push_back(b);
+		offsets.push_back(b - 1);
+		offsets.push_back(b + 1);
+	}
+	offsets.push_back(block_size);
+	offsets.push_back(length / 2);
+
+	ZFileXZ zxz;
+	zxz.open(filename, std::ios_base::in);
+	const size_t bufsize = 4096;
+	char buf[bufsize];
+	int failed = 0;
+	for (uint64_t offset : offsets){
+		size_t expected = length - offset < bufsize ? length - offset : bufsize;
+		bool ok = zxz.seek(offset) && zxz.read(buf, bufsize) == expected &&
+		          0 == memcmp(buf, in.data() + offset, expected);
+		if (!ok){
+			std::cout << "seek: " << offset << " mismatch" << std::endl ;
+			failed++;
+		}
+	}
+	std::cout << "seeks: " << offsets.size() << " failed: " << failed << std::endl ;
+	zxz.close();
+}
+
+void test_seek_001_lzo(const char * filename)
+{
+	/* seek to the second half, and a ranged read of the first bytes */
+	ZFileLZO zlzo;
+	zlzo.open(filename, std::ios_base::in);
+
+	std::ifstream infile ("test.big.txt",std::ifstream::binary | std::ifstream::ate);
+	uint64_t half = (uint64_t)infile.tellg() / 2;
+	zlzo.seek(half);
+
+	const int bufsize = ( 1024 * 1024 ); /* 1M */
+	char * buf = new char[bufsize];
+	size_t size;
+	size_t total = 0;
+	while ((size = zlzo.read(buf, bufsize))){
+		total += size;
+	}
+	std::cout << "seek: " << half << " total: " << total << " tell: " << zlzo.tell() << std::endl ;
+	size = zlzo.readAt(0, buf, 1024);
+	std::cout << "readAt: 0 size: " << size << " tell: " << zlzo.tell() << std::endl ;
+
+	zlzo.close();
+	delete[] buf;
+}
+
+void test_verify_001_lzo(const char * filename)
+{
+	/* break the data checksum of the second block, verify has to catch it */
+	std::ifstream infile (filename, std::ifstream::binary);
+	std::vector<char> data((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+	infile.close();
+	lzop_stream hs = {};
+	lzop_inflateInit(&hs);
+	hs.next_in = (uint8_t*)data.data();
+	hs.avail_in = 512;
+	lzop_inflateHeader(&hs);
+	size_t offset = 512 - hs.avail_in;
+	uint32_t src_len, dst_len;
+	lzop_inflateBlockDesc((uint8_t*)data.data() + offset, &src_len, &dst_len);
+	uint64_t second = src_len;
+	offset += lzop_inflateBlockDescSize(&hs) + (dst_len < src_len ? lzop_inflateBlockChkSize(&hs) : 0) + dst_len;
+	lzop_inflateEnd(&hs);
+	data[offset + 8] ^= 0xff;
+	std::ofstream outfile ("test.big.txt.zutil.bad.lzo", std::ofstream::binary);
+	outfile.write(data.data(), data.size());
+	outfile.close();
+
+	const int bufsize = ( 1024 * 1024 ); /* 1M */
+	char * buf = new char[bufsize];
+	for (int threads : {1, 4}){
+		ZFileLZO::options opt;
+		opt.verify = true;
+		opt.threads = threads;
+		ZFileLZO zlzo(opt);
+		zlzo.open("test.big.txt.zutil.bad.lzo", std::ios_base::in);
+		bool failed = false;
+		try {
+			while (zlzo.read(buf, bufsize));
+		} catch (const char * e) {
+			failed = true;
+		}
+		std::cout << "threads: " << threads << " read failed: " << failed << std::endl ;
+		zlzo.close();
+	}
+	ZFileLZO::options opt;
+	opt.verify = true;
+	ZFileLZO zlzo(opt);
+	zlzo.open("test.big.txt.zutil.bad.lzo", std::ios_base::in);
+	bool failed = false;
+	try {
+		zlzo.readAt(second, buf, 1024);
+	} catch (const char * e) {
+		failed = true;
+	}
+	std::cout << "readAt: " << second << " failed: " << failed << std::endl ;
+	zlzo.close();
+	delete[] buf;
+}
+
+void test_magic_001_bz2(const char * filename)
+{
+	/*
+	 * 1M of bytes whose used-bytes map (group flags, then a bitmap per group)
+	 * reads 0x3141 0x5926 0x5359: every block holds the block magic after its
+	 * header. No byte follows itself, a run would add its length to the map.
+	 */
+	const unsigned char bytes[] = {
+		0x21, 0x23, 0x24, 0x27, 0x2a, 0x2d, 0x2e,
+		0x31, 0x33, 0x36, 0x37, 0x39, 0x3b, 0x3c, 0x3f,
+		0x70, 0x90, 0xf0 };
+	std::vector<char> data;
+	uint32_t x = 1;
+	int prev = -1;
+	while (data.size() < 1024 * 1024){
+		x = (x * 1103515245 + 12345) & 0x7fffffff;
+		int c = bytes[(x >> 16) % sizeof(bytes)];
+		if (c != prev){
+			data.push_back(c);
+			prev = c;
+		}
+	}
+	std::ofstream outfile (filename, std::ofstream::binary);
+	outfile.write(data.data(), data.size());
+	outfile.close();
+}
+
+template <class T>
+void test_oneshot_001(const char * infilename, const char * outfilename, const char * clifilename)
+{
+	/* one-shot compress/decompress of the whole file, in memory */
+	std::ifstream infile (infilename, std::ifstream::binary);
+	std::vector<char> in((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+	infile.close();
+
+	std::vector<char> c = T::compress(in.data(), in.size());
+	std::ofstream outfile (outfilename, std::ofstream::binary);
+	outfile.write(c.data(), c.size());
+	outfile.close();
+
+	std::vector<char> out = T::decompress(c.data(), c.size());
+	std::cout << "compressed: " << c.size() << " total: " << out.size() << " match: " << (out == in) << std::endl ;
+
+	/* a file written by the command line tool */
+	std::ifstream clifile (clifilename, std::ifstream::binary);
+	std::vector<char> cli((std::istreambuf_iterator<char>(clifile)), std::istreambuf_iterator<char>());
+	clifile.close();
+	out = T::decompress(cli.data(), cli.size());
+	std::cout << clifilename << " total: " << out.size() << " match: " << (out == in) << std::endl ;
+}
+
 
 int test_compress_001_lzo() 
 {
@@ -354,6 +622,285 @@ int main(){
 	delete zlo;
 	std::cout << "          ---END---" << std::endl ;
 
+	std::cout << "Test Deflate lzo (4 threads):" << std::endl ;
+	ZFileLZO::options lopt;
+	lopt.threads = 4;
+	zlo = new ZFileLZO(lopt);
+	test_deflate_001(zlo, "test.big.txt", "test.big.txt.zutil.mt.lzo");
+	delete zlo;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate xz (4 threads):" << std::endl ;
+	ZFileXZ::options xopt;
+	xopt.threads = 4;
+	xopt.block_size = 256 * 1024; /* many blocks to decode in parallel */
+	ZFileXZ *zxz = new ZFileXZ(xopt);
+	test_deflate_001(zxz, "test.big.txt", "test.big.txt.zutil.mt.xz");
+	delete zxz;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Inflate xz (4 threads):" << std::endl ;
+	zxz = new ZFileXZ(xopt);
+	test_inflate_002(zxz, "test.big.txt.zutil.mt.xz", "test.big.txt.zutil.mt.xz.out");
+	delete zxz;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate gz (4 threads):" << std::endl ;
+	ZFileGZ::options gopt;
+	gopt.threads = 4;
+	ZFileGZ *zgz = new ZFileGZ(gopt);
+	test_deflate_001(zgz, "test.big.txt", "test.big.txt.zutil.mt.gz");
+	delete zgz;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Peek gz:" << std::endl ;
+	zgz = new ZFileGZ();
+	test_peek_001(zgz, "test.big.txt.zutil.mt.gz");
+	delete zgz;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Seek gz:" << std::endl ;
+	test_seek_001_gz("test.big.txt.zutil.mt.gz");
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Seek xz:" << std::endl ;
+	test_seek_001_xz("test.big.txt.zutil.mt.xz");
+	test_seek_002_xz("test.big.txt.zutil.mt.xz", xopt.block_size);
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Seek lzo:" << std::endl ;
+	test_seek_001_lzo("test.big.txt.zutil.lzo");
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate/Inflate xz (fd, O_DIRECT):" << std::endl ;
+	ZIOFd::options fopt;
+	fopt.direct = true;
+	fopt.dontneed = true;
+	zxz = new ZFileXZ();
+	zxz->setIO(new ZIOFd(fopt));
+	test_deflate_001(zxz, "test.big.txt", "test.big.txt.zutil.fd.xz");
+	delete zxz;
+	zxz = new ZFileXZ();
+	zxz->setIO(new ZIOFd(fopt));
+	test_inflate_001(zxz, "test.big.txt.zutil.fd.xz");
+	delete zxz;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Inflate gz/xz/lzo (mmap):" << std::endl ;
+	zgz = new ZFileGZ();
+	zgz->setIO(new ZIOMmap());
+	test_inflate_001(zgz, "test.big.txt.gz");
+	delete zgz;
+	zxz = new ZFileXZ();
+	zxz->setIO(new ZIOMmap());
+	test_inflate_001(zxz, "test.big.txt.xz");
+	delete zxz;
+	zlo = new ZFileLZO();
+	zlo->setIO(new ZIOMmap());
+	test_inflate_001(zlo, "test.big.txt.lzo");
+	delete zlo;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate/Inflate gz (io_uring):" << std::endl ;
+	zgz = new ZFileGZ();
+	zgz->setIO(new ZIOUring());
+	test_deflate_001(zgz, "test.big.txt", "test.big.txt.zutil.uring.gz");
+	delete zgz;
+	zgz = new ZFileGZ();
+	zgz->setIO(new ZIOUring());
+	test_inflate_001(zgz, "test.big.txt.zutil.uring.gz");
+	delete zgz;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Inflate xz (read-ahead):" << std::endl ;
+	ZIOReadAhead::options raopt;
+	raopt.depth = 8;
+	zxz = new ZFileXZ();
+	zxz->setIO(new ZIOReadAhead(raopt));
+	test_inflate_001(zxz, "test.big.txt.xz");
+	delete zxz;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate xz (write-behind):" << std::endl ;
+	ZFileAsync *zas = new ZFileAsync(new ZFileXZ());
+	test_deflate_001(zas, "test.big.txt", "test.big.txt.zutil.async.xz");
+	delete zas;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate gz/xz (fastest profile):" << std::endl ;
+	zgz = new ZFileGZ(ZFileGZ::options::fastest());
+	test_deflate_001(zgz, "test.big.txt", "test.big.txt.zutil.fast.gz");
+	delete zgz;
+	zxz = new ZFileXZ(ZFileXZ::options::fastest());
+	test_deflate_001(zxz, "test.big.txt", "test.big.txt.zutil.fast.xz");
+	delete zxz;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate lzo (lzo1x_1):" << std::endl ;
+	ZFileLZO::options l1opt;
+	l1opt.method = ZFileLZO::options::lzo1x_1;
+	l1opt.level = 3;
+	zlo = new ZFileLZO(l1opt);
+	test_deflate_001(zlo, "test.big.txt", "test.big.txt.zutil.1x1.lzo");
+	delete zlo;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate/Inflate lzo (crc32, verify):" << std::endl ;
+	ZFileLZO::options copt;
+	copt.chk = ZFileLZO::options::crc32;
+	copt.verify = true;
+	zlo = new ZFileLZO(copt);
+	test_deflate_001(zlo, "test.big.txt", "test.big.txt.zutil.crc.lzo");
+	delete zlo;
+	zlo = new ZFileLZO(copt);
+	test_inflate_001(zlo, "test.big.txt.zutil.crc.lzo");
+	delete zlo;
+	test_verify_001_lzo("test.big.txt.zutil.crc.lzo");
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate/Inflate lzo (4M blocks):" << std::endl ;
+	ZFileLZO::options bopt;
+	bopt.block_size = 4 * 1024 * 1024;
+	bopt.threads = 4;
+	zlo = new ZFileLZO(bopt);
+	test_deflate_001(zlo, "test.big.txt", "test.big.txt.zutil.4m.lzo");
+	delete zlo;
+	zlo = new ZFileLZO(lopt);
+	test_inflate_002(zlo, "test.big.txt.zutil.4m.lzo", "test.big.txt.zutil.4m.lzo.out");
+	delete zlo;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Inflate gz/xz/lzo (large reads):" << std::endl ;
+	zgz = new ZFileGZ();
+	test_inflate_002(zgz, "test.big.txt.gz", "test.big.txt.zutil.gz.out");
+	delete zgz;
+	zxz = new ZFileXZ();
+	test_inflate_002(zxz, "test.big.txt.xz", "test.big.txt.zutil.xz.out");
+	delete zxz;
+	zlo = new ZFileLZO();
+	test_inflate_002(zlo, "test.big.txt.lzo", "test.big.txt.zutil.lzo.out");
+	delete zlo;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Inflate lzo (4 threads):" << std::endl ;
+	zlo = new ZFileLZO(lopt);
+	test_inflate_002(zlo, "test.big.txt.lzo", "test.big.txt.zutil.mt.lzo.out");
+	delete zlo;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test zstd:" << std::endl ;
+	ZFileZSTD *zst = new ZFileZSTD();
+	test_inflate_001(zst, "test.big.txt.zst");
+	delete zst;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate zstd:" << std::endl ;
+	zst = new ZFileZSTD();
+	test_deflate_001(zst, "test.big.txt", "test.big.txt.zutil.zst");
+	delete zst;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate zstd (4 threads, long distance):" << std::endl ;
+	ZFileZSTD::options zopt;
+	zopt.threads = 4;
+	zopt.long_distance = true;
+	zst = new ZFileZSTD(zopt);
+	test_deflate_001(zst, "test.big.txt", "test.big.txt.zutil.mt.zst");
+	delete zst;
+	zst = new ZFileZSTD(zopt);
+	test_inflate_001(zst, "test.big.txt.zutil.mt.zst");
+	delete zst;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test lz4:" << std::endl ;
+	ZFileLZ4 *zl4 = new ZFileLZ4();
+	test_inflate_001(zl4, "test.big.txt.lz4");
+	delete zl4;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate lz4:" << std::endl ;
+	zl4 = new ZFileLZ4();
+	test_deflate_001(zl4, "test.big.txt", "test.big.txt.zutil.lz4");
+	delete zl4;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate lz4 (hc, linked blocks, block checksums):" << std::endl ;
+	ZFileLZ4::options l4opt = ZFileLZ4::options::balanced();
+	l4opt.block_independent = false;
+	l4opt.block_checksum = true;
+	zl4 = new ZFileLZ4(l4opt);
+	test_deflate_001(zl4, "test.big.txt", "test.big.txt.zutil.hc.lz4");
+	delete zl4;
+	zl4 = new ZFileLZ4(l4opt);
+	test_inflate_001(zl4, "test.big.txt.zutil.hc.lz4");
+	delete zl4;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test bz2:" << std::endl ;
+	ZFileBZ2 *zb2 = new ZFileBZ2();
+	test_inflate_001(zb2, "test.big.txt.bz2");
+	delete zb2;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate bz2:" << std::endl ;
+	zb2 = new ZFileBZ2();
+	test_deflate_001(zb2, "test.big.txt", "test.big.txt.zutil.bz2");
+	delete zb2;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Deflate bz2 (4 threads):" << std::endl ;
+	ZFileBZ2::options b2opt;
+	b2opt.threads = 4;
+	zb2 = new ZFileBZ2(b2opt);
+	test_deflate_001(zb2, "test.big.txt", "test.big.txt.zutil.mt.bz2");
+	delete zb2;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Inflate bz2 (4 threads):" << std::endl ;
+	zb2 = new ZFileBZ2(b2opt);
+	test_inflate_002(zb2, "test.big.txt.bz2", "test.big.txt.bz2.mt.out");
+	delete zb2;
+	zb2 = new ZFileBZ2(b2opt);
+	test_inflate_002(zb2, "test.big.txt.zutil.mt.bz2", "test.big.txt.zutil.mt.bz2.out");
+	delete zb2;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test Inflate bz2 (block magic in the data, 4 threads):" << std::endl ;
+	test_magic_001_bz2("test.magic.txt");
+	ZFileBZ2::options m2opt;
+	m2opt.level = 1;
+	zb2 = new ZFileBZ2(m2opt);
+	test_deflate_001(zb2, "test.magic.txt", "test.magic.txt.zutil.bz2");
+	delete zb2;
+	zb2 = new ZFileBZ2(b2opt);
+	test_inflate_002(zb2, "test.magic.txt.zutil.bz2", "test.magic.txt.zutil.bz2.out");
+	delete zb2;
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test one-shot gz:" << std::endl ;
+	test_oneshot_001<ZFileGZ>("test.big.txt", "test.big.txt.zutil.oneshot.gz", "test.big.txt.gz");
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test one-shot xz:" << std::endl ;
+	test_oneshot_001<ZFileXZ>("test.big.txt", "test.big.txt.zutil.oneshot.xz", "test.big.txt.xz");
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test one-shot lzo:" << std::endl ;
+	test_oneshot_001<ZFileLZO>("test.big.txt", "test.big.txt.zutil.oneshot.lzo", "test.big.txt.lzo");
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test one-shot zstd:" << std::endl ;
+	test_oneshot_001<ZFileZSTD>("test.big.txt", "test.big.txt.zutil.oneshot.zst", "test.big.txt.zst");
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test one-shot lz4:" << std::endl ;
+	test_oneshot_001<ZFileLZ4>("test.big.txt", "test.big.txt.zutil.oneshot.lz4", "test.big.txt.lz4");
+	std::cout << "          ---END---" << std::endl ;
+
+	std::cout << "Test one-shot bz2:" << std::endl ;
+	test_oneshot_001<ZFileBZ2>("test.big.txt", "test.big.txt.zutil.oneshot.bz2", "test.big.txt.bz2");
+	std::cout << "          ---END---" << std::endl ;
+
 	return 0;
 }
 
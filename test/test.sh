@@ -46,9 +46,41 @@ cat test.big.txt | gzip -9 -c > test.big.txt.9.gz
 cat test.big.txt | lzop -c    > test.big.txt.lzo
 cat test.big.txt | lzop -9 -c > test.big.txt.9.lzo
 cat test.big.txt | xz --check=crc32 --arm --lzma2=,dict=32MiB -c > test.big.txt.arm.lzma.xz
+cat test.big.txt | zstd -c    > test.big.txt.zst
+cat test.big.txt | lz4 -c     > test.big.txt.lz4
+cat test.big.txt | bzip2 -c   > test.big.txt.bz2
 
 make
 ./test.out
 
 md5sum test.big* | sort
 
+cmp test.big.txt.zutil.lzo test.big.txt.zutil.mt.lzo && echo "lzo: multithreaded output matches"
+xz -dc test.big.txt.zutil.mt.xz | cmp - test.big.txt && echo "xz: multithreaded output decodes"
+cmp test.big.txt.zutil.mt.xz.out test.big.txt && echo "xz: multithreaded inflate matches"
+
+gzip -dc test.big.txt.zutil.mt.gz | cmp - test.big.txt && echo "gz: multithreaded output decodes"
+xz -dc test.big.txt.zutil.fd.xz | cmp - test.big.txt && echo "xz: fd backend output decodes"
+gzip -dc test.big.txt.zutil.uring.gz | cmp - test.big.txt && echo "gz: io_uring backend output decodes"
+xz -dc test.big.txt.zutil.async.xz | cmp - test.big.txt && echo "xz: write-behind output decodes"
+gzip -dc test.big.txt.zutil.fast.gz | cmp - test.big.txt && echo "gz: fastest profile output decodes"
+xz -dc test.big.txt.zutil.fast.xz | cmp - test.big.txt && echo "xz: fastest profile output decodes"
+lzop -dc test.big.txt.zutil.1x1.lzo | cmp - test.big.txt && echo "lzo: lzo1x_1 output decodes"
+lzop -dc test.big.txt.zutil.crc.lzo | cmp - test.big.txt && echo "lzo: crc32 output decodes"
+lzop -dc test.big.txt.zutil.4m.lzo | cmp - test.big.txt && echo "lzo: 4M blocks output decodes"
+cmp test.big.txt.zutil.gz.out test.big.txt && cmp test.big.txt.zutil.xz.out test.big.txt && cmp test.big.txt.zutil.lzo.out test.big.txt && echo "gz/xz/lzo: large reads match"
+cmp test.big.txt.zutil.mt.lzo.out test.big.txt && cmp test.big.txt.zutil.4m.lzo.out test.big.txt && echo "lzo: multithreaded inflate matches"
+zstd -dc test.big.txt.zutil.zst | cmp - test.big.txt && echo "zstd: output decodes"
+zstd -dc --long=27 test.big.txt.zutil.mt.zst | cmp - test.big.txt && echo "zstd: multithreaded long distance output decodes"
+lz4 -dc test.big.txt.zutil.lz4 | cmp - test.big.txt && echo "lz4: output decodes"
+lz4 -dc test.big.txt.zutil.hc.lz4 | cmp - test.big.txt && echo "lz4: hc linked blocks output decodes"
+bzip2 -dc test.big.txt.zutil.bz2 | cmp - test.big.txt && echo "bz2: output decodes"
+bzip2 -dc test.big.txt.zutil.mt.bz2 | cmp - test.big.txt && echo "bz2: multithreaded output decodes"
+cmp test.big.txt.bz2.mt.out test.big.txt && cmp test.big.txt.zutil.mt.bz2.out test.big.txt && echo "bz2: multithreaded inflate matches"
+bzip2 -dc test.magic.txt.zutil.bz2 | cmp - test.magic.txt && cmp test.magic.txt.zutil.bz2.out test.magic.txt && echo "bz2: block magic in the data inflate matches"
+gzip -dc test.big.txt.zutil.oneshot.gz | cmp - test.big.txt && echo "gz: one-shot output decodes"
+xz -dc test.big.txt.zutil.oneshot.xz | cmp - test.big.txt && echo "xz: one-shot output decodes"
+lzop -dc test.big.txt.zutil.oneshot.lzo | cmp - test.big.txt && echo "lzo: one-shot output decodes"
+zstd -dc test.big.txt.zutil.oneshot.zst | cmp - test.big.txt && echo "zstd: one-shot output decodes"
+lz4 -dc test.big.txt.zutil.oneshot.lz4 | cmp - test.big.txt && echo "lz4: one-shot output decodes"
+bzip2 -dc test.big.txt.zutil.oneshot.bz2 | cmp - test.big.txt && echo "bz2: one-shot output decodes"